@@ -0,0 +1,93 @@
+#include "collision.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+// NOTE: Roughly as crowded as a big fight, one unit every two tiles
+static constexpr float kTilesPerUnit = 2.f;
+static constexpr float kUnitRadius = 0.5f;
+
+struct CollisionScene {
+    SweepAndPrune broadphase;
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec2> velocities;
+    float side;
+
+    explicit CollisionScene(uint32_t unitCount) {
+        side = sqrtf((float)unitCount * kTilesPerUnit);
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> position(0.f, side);
+        std::uniform_real_distribution<float> velocity(-2.f, 2.f);
+
+        positions.resize(unitCount);
+        velocities.resize(unitCount);
+        for (uint32_t i = 0; i < unitCount; i++) {
+            positions[i] = glm::vec2(position(rng), position(rng));
+            velocities[i] = glm::vec2(velocity(rng), velocity(rng));
+            broadphase.insert((entt::entity)i, positions[i] - kUnitRadius,
+                              positions[i] + kUnitRadius);
+        }
+    }
+
+    void step(float dt) {
+        for (uint32_t i = 0; i < positions.size(); i++) {
+            positions[i] += velocities[i] * dt;
+            // NOTE: Bounce off the borders so the density stays the same
+            for (int axis = 0; axis < 2; axis++) {
+                if (positions[i][axis] < 0.f || positions[i][axis] > side) {
+                    velocities[i][axis] = -velocities[i][axis];
+                }
+            }
+            broadphase.update((entt::entity)i, positions[i] - kUnitRadius,
+                              positions[i] + kUnitRadius);
+        }
+    }
+};
+
+static void BM_SweepAndPrune(benchmark::State &state) {
+    CollisionScene scene((uint32_t)state.range(0));
+    std::vector<CollisionPair> pairs;
+    int64_t pairCount = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        scene.step(1.f / 60.f);
+        pairs.clear();
+        state.ResumeTiming();
+
+        scene.broadphase.find_pairs(pairs);
+        benchmark::DoNotOptimize(pairs.data());
+        pairCount += (int64_t)pairs.size();
+    }
+
+    state.counters["pairs"] = benchmark::Counter(
+        (double)pairCount, benchmark::Counter::kAvgIterations);
+    state.counters["pairs/s"] =
+        benchmark::Counter((double)pairCount, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SweepAndPrune)->Arg(1000)->Arg(10000)->Arg(50000);
+
+static void BM_SweepAndPruneNarrowphase(benchmark::State &state) {
+    CollisionScene scene((uint32_t)state.range(0));
+    std::vector<CollisionPair> pairs;
+    int64_t pairCount = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        scene.step(1.f / 60.f);
+        pairs.clear();
+        state.ResumeTiming();
+
+        scene.broadphase.find_pairs(pairs);
+        for (const CollisionPair &pair : pairs) {
+            resolve_circle_circle(scene.positions[(uint32_t)pair.a],
+                                  kUnitRadius,
+                                  scene.positions[(uint32_t)pair.b],
+                                  kUnitRadius);
+        }
+        pairCount += (int64_t)pairs.size();
+    }
+
+    state.counters["pairs/s"] =
+        benchmark::Counter((double)pairCount, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SweepAndPruneNarrowphase)->Arg(1000)->Arg(10000)->Arg(50000);
@@ -0,0 +1,114 @@
+#include "cpu.h"
+#include "renderer/frustum_culling.h"
+#include <benchmark/benchmark.h>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <random>
+
+struct CullingScene {
+    std::vector<glm::mat4> transforms;
+    std::vector<Bounds> bounds;
+    glm::mat4 viewproj;
+
+    explicit CullingScene(uint32_t drawCount) {
+        // NOTE: Units spread over a square map seen from above at an angle,
+        // with the far corners of the map off screen
+        float side = sqrtf((float)drawCount * 4.f);
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> position(0.f, side);
+        std::uniform_real_distribution<float> scale(0.5f, 2.f);
+
+        Bounds unitBounds;
+        unitBounds.origin = glm::vec3(0.f, 0.5f, 0.f);
+        unitBounds.extents = glm::vec3(0.4f, 0.5f, 0.4f);
+        unitBounds.sphereRadius = glm::length(unitBounds.extents);
+
+        transforms.resize(drawCount);
+        bounds.resize(drawCount, unitBounds);
+        for (uint32_t i = 0; i < drawCount; i++) {
+            glm::vec3 translation(position(rng), 0.f, position(rng));
+            transforms[i] =
+                glm::scale(glm::translate(glm::mat4(1.f), translation),
+                           glm::vec3(scale(rng)));
+        }
+
+        glm::vec3 target(side * 0.5f, 0.f, side * 0.5f);
+        glm::mat4 view = glm::lookAt(target + glm::vec3(0.f, side * 0.4f,
+                                                        side * 0.3f),
+                                     target, glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 proj =
+            glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, side * 2.f);
+        viewproj = proj * view;
+    }
+};
+
+static void BM_IsVisible(benchmark::State &state) {
+    CullingScene scene((uint32_t)state.range(0));
+    std::vector<uint32_t> visible;
+    visible.reserve(scene.transforms.size());
+
+    for (auto _ : state) {
+        visible.clear();
+        for (uint32_t i = 0; i < scene.transforms.size(); i++) {
+            if (vkutil::is_visible(scene.transforms[i], scene.bounds[i],
+                                   scene.viewproj)) {
+                visible.push_back(i);
+            }
+        }
+        benchmark::DoNotOptimize(visible.data());
+    }
+
+    state.counters["visible"] = (double)visible.size();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_IsVisible)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_Cull(benchmark::State &state) {
+    CullingScene scene((uint32_t)state.range(0));
+    force_simd_level((SimdLevel)state.range(1));
+    vkutil::CullingBounds cullingBounds;
+    for (uint32_t i = 0; i < scene.transforms.size(); i++) {
+        cullingBounds.push_back(scene.transforms[i], scene.bounds[i]);
+    }
+    std::vector<uint32_t> visible;
+    visible.reserve(scene.transforms.size());
+
+    for (auto _ : state) {
+        visible.clear();
+        vkutil::cull(math::frustum_from_matrix(scene.viewproj), cullingBounds,
+                     visible);
+        benchmark::DoNotOptimize(visible.data());
+    }
+
+    state.counters["visible"] = (double)visible.size();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(simd_level_name(simd_level()));
+    force_simd_level(SimdLevel::kAVX2);
+}
+BENCHMARK(BM_Cull)->ArgsProduct({{1000, 10000, 100000},
+                                 {(int64_t)SimdLevel::kSSE2,
+                                  (int64_t)SimdLevel::kAVX2}});
+
+// NOTE: What the renderer pays for meshes, whose bounds are rebuilt from the
+// draw commands every frame
+static void BM_CullWithBoundsUpdate(benchmark::State &state) {
+    CullingScene scene((uint32_t)state.range(0));
+    vkutil::CullingBounds cullingBounds;
+    std::vector<uint32_t> visible;
+    visible.reserve(scene.transforms.size());
+
+    for (auto _ : state) {
+        cullingBounds.clear();
+        for (uint32_t i = 0; i < scene.transforms.size(); i++) {
+            cullingBounds.push_back(scene.transforms[i], scene.bounds[i]);
+        }
+        visible.clear();
+        vkutil::cull(math::frustum_from_matrix(scene.viewproj), cullingBounds,
+                     visible);
+        benchmark::DoNotOptimize(visible.data());
+    }
+
+    state.counters["visible"] = (double)visible.size();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CullWithBoundsUpdate)->Arg(1000)->Arg(10000)->Arg(100000);
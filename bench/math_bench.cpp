@@ -0,0 +1,159 @@
+#include "math/aabb.h"
+#include "math/aabb_batch.h"
+#include "math/intersection.h"
+#include "math/transform.h"
+#include <benchmark/benchmark.h>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <random>
+
+static std::vector<glm::mat4> random_matrices(uint32_t count) {
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> position(-50.f, 50.f);
+    std::uniform_real_distribution<float> angle(0.f, 6.28f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.f);
+
+    std::vector<glm::mat4> matrices(count);
+    for (glm::mat4 &matrix : matrices) {
+        matrix = glm::translate(
+            glm::mat4(1.f),
+            glm::vec3(position(rng), position(rng), position(rng)));
+        matrix =
+            glm::rotate(matrix, angle(rng), glm::vec3(0.f, 1.f, 0.f));
+        matrix = glm::scale(matrix, glm::vec3(scale(rng)));
+    }
+    return matrices;
+}
+
+static std::vector<math::AABB> random_aabbs(uint32_t count, float side) {
+    std::mt19937 rng(7331);
+    std::uniform_real_distribution<float> position(0.f, side);
+    std::uniform_real_distribution<float> size(0.2f, 2.f);
+
+    std::vector<math::AABB> aabbs(count);
+    for (math::AABB &aabb : aabbs) {
+        aabb.min = glm::vec3(position(rng), 0.f, position(rng));
+        aabb.max = aabb.min + glm::vec3(size(rng), size(rng), size(rng));
+    }
+    return aabbs;
+}
+
+static void BM_AABBTransform(benchmark::State &state) {
+    uint32_t count = (uint32_t)state.range(0);
+    std::vector<glm::mat4> matrices = random_matrices(count);
+    std::vector<math::AABB> aabbs = random_aabbs(count, 100.f);
+    std::vector<math::AABB> out(count);
+
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = aabbs[i].transform(matrices[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_AABBTransform)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_AABBTransformProjective(benchmark::State &state) {
+    uint32_t count = (uint32_t)state.range(0);
+    std::vector<glm::mat4> matrices = random_matrices(count);
+    std::vector<math::AABB> aabbs = random_aabbs(count, 100.f);
+    std::vector<math::AABB> out(count);
+
+    glm::mat4 proj =
+        glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 200.f);
+    for (glm::mat4 &matrix : matrices) {
+        matrix = proj * matrix;
+    }
+
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = aabbs[i].transform_projective(matrices[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_AABBTransformProjective)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// NOTE: The world bounds refresh of moved units, one local box by every world
+// matrix. The second argument selects the batch kernel over the scalar loop.
+static void BM_AABBTransformInstances(benchmark::State &state) {
+    uint32_t count = (uint32_t)state.range(0);
+    bool useBatch = state.range(1) != 0;
+    std::vector<glm::mat4> matrices = random_matrices(count);
+    math::AABB aabb{glm::vec3(-0.5f, 0.f, -0.5f), glm::vec3(0.5f, 2.f, 0.5f)};
+    std::vector<math::AABB> out(count);
+
+    for (auto _ : state) {
+        if (useBatch) {
+            math::transform_aabb_instances(aabb, matrices, out);
+        } else {
+            for (uint32_t i = 0; i < count; i++) {
+                out[i] = aabb.transform(matrices[i]);
+            }
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetLabel(useBatch ? "batch" : "scalar");
+}
+BENCHMARK(BM_AABBTransformInstances)
+    ->ArgsProduct({{1000, 10000, 100000}, {0, 1}});
+
+// NOTE: One ray from above the map against every box, like a pick without an
+// acceleration structure. The second argument selects the RayPacket overload.
+static void BM_IntersectRayAABB(benchmark::State &state) {
+    uint32_t count = (uint32_t)state.range(0);
+    bool usePacket = state.range(1) != 0;
+    std::vector<math::AABB> aabbs = random_aabbs(count, 100.f);
+
+    Ray ray;
+    ray.origin = glm::vec3(0.f, 40.f, 0.f);
+    ray.direction = glm::normalize(glm::vec3(50.f, -40.f, 50.f));
+    math::RayPacket packet(ray);
+
+    uint32_t hits = 0;
+    for (auto _ : state) {
+        hits = 0;
+        for (const math::AABB &aabb : aabbs) {
+            float distance;
+            bool hit = usePacket
+                           ? math::intersect_ray_aabb(packet, aabb, 1000.f,
+                                                      distance)
+                           : math::intersect_ray_aabb(ray, aabb, distance);
+            hits += hit;
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+
+    state.counters["hits"] = (double)hits;
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetLabel(usePacket ? "packet" : "ray");
+}
+BENCHMARK(BM_IntersectRayAABB)->ArgsProduct({{1000, 10000, 100000}, {0, 1}});
+
+// NOTE: The matrix is cached, so every transform is touched first to measure
+// the rebuild the game pays for each moved entity
+static void BM_TransformAsMatrix(benchmark::State &state) {
+    uint32_t count = (uint32_t)state.range(0);
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> position(-50.f, 50.f);
+    std::uniform_real_distribution<float> angle(0.f, 6.28f);
+
+    std::vector<Transform> transforms(count);
+    for (Transform &transform : transforms) {
+        transform.position(glm::vec3(position(rng), 0.f, position(rng)));
+        transform.heading(
+            glm::angleAxis(angle(rng), glm::vec3(0.f, 1.f, 0.f)));
+    }
+
+    for (auto _ : state) {
+        for (Transform &transform : transforms) {
+            transform.position(transform.position());
+            benchmark::DoNotOptimize(transform.as_matrix());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_TransformAsMatrix)->Arg(1000)->Arg(10000)->Arg(100000);
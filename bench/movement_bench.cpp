@@ -0,0 +1,84 @@
+#include "cpu.h"
+#include "math/global_axis.h"
+#include "movement.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+static MoverArrays random_movers(uint32_t count) {
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> position(0.f, 512.f);
+
+    MoverArrays movers;
+    for (uint32_t i = 0; i < count; i++) {
+        movers.add((entt::entity)i, i, glm::vec2(position(rng), position(rng)),
+                   glm::vec2(position(rng), position(rng)), 2.f);
+    }
+    return movers;
+}
+
+static std::vector<glm::vec2> random_velocities(uint32_t count) {
+    std::mt19937 rng(7331);
+    std::uniform_real_distribution<float> velocity(-2.f, 2.f);
+
+    std::vector<glm::vec2> velocities(count);
+    for (glm::vec2 &v : velocities) {
+        v = glm::vec2(velocity(rng), velocity(rng));
+    }
+    return velocities;
+}
+
+static void BM_SteerMovers(benchmark::State &state) {
+    MoverArrays movers = random_movers((uint32_t)state.range(0));
+    force_simd_level((SimdLevel)state.range(1));
+
+    for (auto _ : state) {
+        steer_movers(movers, 0.1f, 1.f / 60.f);
+        benchmark::DoNotOptimize(movers.velocityX.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(simd_level_name(simd_level()));
+    force_simd_level(SimdLevel::kAVX2);
+}
+BENCHMARK(BM_SteerMovers)
+    ->ArgsProduct({{1000, 10000, 100000},
+                   {(int64_t)SimdLevel::kSSE2, (int64_t)SimdLevel::kAVX2}});
+
+// NOTE: What update_positions used to do for every moving unit
+static void BM_QuatLookAt(benchmark::State &state) {
+    std::vector<glm::vec2> velocities =
+        random_velocities((uint32_t)state.range(0));
+    std::vector<glm::quat> headings(velocities.size());
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < velocities.size(); i++) {
+            glm::quat target = glm::quatLookAt(
+                glm::normalize(
+                    glm::vec3(velocities[i].x, 0.f, velocities[i].y)),
+                math::GLOBAL_UP_AXIS);
+            headings[i] = glm::slerp(headings[i], target, 1.f);
+        }
+        benchmark::DoNotOptimize(headings.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QuatLookAt)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_ComputeHeadings(benchmark::State &state) {
+    std::vector<glm::vec2> velocities =
+        random_velocities((uint32_t)state.range(0));
+    HeadingArrays headings;
+    force_simd_level((SimdLevel)state.range(1));
+
+    for (auto _ : state) {
+        compute_headings(velocities, headings);
+        benchmark::DoNotOptimize(headings.w.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(simd_level_name(simd_level()));
+    force_simd_level(SimdLevel::kAVX2);
+}
+BENCHMARK(BM_ComputeHeadings)
+    ->ArgsProduct({{1000, 10000, 100000},
+                   {(int64_t)SimdLevel::kSSE2, (int64_t)SimdLevel::kAVX2}});
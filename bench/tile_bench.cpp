@@ -0,0 +1,72 @@
+#include "tile.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+struct TileScene {
+    std::vector<uint8_t> memory;
+    Arena arena;
+    TileMap *tileMap;
+
+    explicit TileScene(uint32_t chunksPerSide) {
+        memory.resize(64 * 1024 * 1024);
+        arena_init(&arena, memory.size(), memory.data());
+        tileMap =
+            generate_world(&arena, chunksPerSide, chunksPerSide)->tile_map;
+    }
+};
+
+static void BM_IsWorldPointTraversible(benchmark::State &state) {
+    uint32_t count = (uint32_t)state.range(0);
+    TileScene scene(2);
+    uint32_t side = scene.tileMap->n_tile_chunk_x * scene.tileMap->chunk_dim;
+
+    // NOTE: Offsets reach into the next tile, so normalizing has work to do
+    // but never leaves the map
+    std::mt19937 rng(1337);
+    std::uniform_int_distribution<uint32_t> tile(1, side - 3);
+    float tileSide = scene.tileMap->tile_side;
+    std::uniform_real_distribution<float> offset(0.f, 2.f * tileSide);
+    std::vector<WorldPosition> points(count);
+    for (WorldPosition &point : points) {
+        point.abs_tile_x = tile(rng);
+        point.abs_tile_y = tile(rng);
+        point.tile_rel_x = offset(rng);
+        point.tile_rel_y = offset(rng);
+    }
+
+    uint32_t traversible = 0;
+    for (auto _ : state) {
+        traversible = 0;
+        for (const WorldPosition &point : points) {
+            traversible += is_world_point_traversible(scene.tileMap, point);
+        }
+        benchmark::DoNotOptimize(traversible);
+    }
+
+    state.counters["traversible"] = (double)traversible;
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_IsWorldPointTraversible)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// NOTE: The second argument builds the chunks with the job system
+static void BM_CreateTileMapMesh(benchmark::State &state) {
+    TileScene scene((uint32_t)state.range(0));
+    uint32_t tileCount = scene.tileMap->n_tile_chunk_x *
+                         scene.tileMap->n_tile_chunk_y *
+                         scene.tileMap->chunk_dim * scene.tileMap->chunk_dim;
+
+    JobSystem jobs;
+    jobs.init();
+    JobSystem *jobsArg = state.range(1) != 0 ? &jobs : nullptr;
+
+    for (auto _ : state) {
+        std::vector<TileRenderingInput> chunks =
+            create_tile_map_mesh(scene.tileMap, jobsArg);
+        benchmark::DoNotOptimize(chunks.data());
+    }
+
+    jobs.deinit();
+    state.SetItemsProcessed(state.iterations() * tileCount);
+    state.SetLabel(jobsArg ? "jobs" : "serial");
+}
+BENCHMARK(BM_CreateTileMapMesh)->ArgsProduct({{2, 4, 8}, {0, 1}});
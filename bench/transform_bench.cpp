@@ -0,0 +1,124 @@
+#include "math/transform.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+enum class Scaling {
+    kUniform,
+    kNonUniform,
+    /// Every transform picks one of the above at random
+    kMixed,
+};
+
+static std::vector<Transform> random_transforms(uint32_t count,
+                                                Scaling scaling) {
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> position(-50.f, 50.f);
+    std::uniform_real_distribution<float> axis(-1.f, 1.f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.f);
+    std::bernoulli_distribution coin(0.5);
+
+    std::vector<Transform> transforms(count);
+    for (Transform &transform : transforms) {
+        transform.position(
+            glm::vec3(position(rng), position(rng), position(rng)));
+        transform.heading(glm::normalize(
+            glm::quat(axis(rng), axis(rng), axis(rng), axis(rng))));
+        bool isUniform = scaling == Scaling::kUniform ||
+                         (scaling == Scaling::kMixed && coin(rng));
+        if (isUniform) {
+            transform.scale(glm::vec3(scale(rng)));
+        } else {
+            transform.scale(glm::vec3(scale(rng), scale(rng), scale(rng)));
+        }
+    }
+    return transforms;
+}
+
+static void assert_matrices_match(const glm::mat4 &a, const glm::mat4 &b) {
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            assert(std::abs(a[column][row] - b[column][row]) <=
+                   1e-3f * std::max(1.f, std::abs(b[column][row])));
+        }
+    }
+}
+
+/// Asserts that operator* and inverse() give what the matrix product and
+/// inverse gave once decomposed, along chains of kChainLength transforms
+static void check_against_matrices(const std::vector<Transform> &transforms) {
+    constexpr size_t kChainLength = 4;
+    for (size_t start = 0; start + kChainLength <= transforms.size();
+         start += kChainLength) {
+        Transform composed = transforms[start];
+        Transform decomposed = transforms[start];
+        for (size_t i = start + 1; i < start + kChainLength; i++) {
+            composed = composed * transforms[i];
+            decomposed =
+                Transform(decomposed.as_matrix() * transforms[i].as_matrix());
+            assert_matrices_match(composed.as_matrix(),
+                                  decomposed.as_matrix());
+            assert_matrices_match(
+                composed.inverse().as_matrix(),
+                Transform(glm::inverse(decomposed.as_matrix())).as_matrix());
+        }
+    }
+}
+
+// NOTE: What operator* used to do for every pair of transforms
+static void BM_TransformComposeDecompose(benchmark::State &state) {
+    Scaling scaling = (Scaling)state.range(0);
+    std::vector<Transform> transforms = random_transforms(1024, scaling);
+    for (auto _ : state) {
+        for (size_t i = 0; i + 1 < transforms.size(); i++) {
+            Transform result(transforms[i].as_matrix() *
+                             transforms[i + 1].as_matrix());
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (transforms.size() - 1));
+}
+BENCHMARK(BM_TransformComposeDecompose)->DenseRange(0, 2)->ArgName("scaling");
+
+static void BM_TransformCompose(benchmark::State &state) {
+    Scaling scaling = (Scaling)state.range(0);
+    std::vector<Transform> transforms = random_transforms(1024, scaling);
+    check_against_matrices(transforms);
+    for (auto _ : state) {
+        for (size_t i = 0; i + 1 < transforms.size(); i++) {
+            Transform result = transforms[i] * transforms[i + 1];
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (transforms.size() - 1));
+}
+BENCHMARK(BM_TransformCompose)->DenseRange(0, 2)->ArgName("scaling");
+
+static void BM_TransformInverseDecompose(benchmark::State &state) {
+    Scaling scaling = (Scaling)state.range(0);
+    std::vector<Transform> transforms = random_transforms(1024, scaling);
+    for (auto _ : state) {
+        for (const Transform &transform : transforms) {
+            Transform result(glm::inverse(transform.as_matrix()));
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * transforms.size());
+}
+BENCHMARK(BM_TransformInverseDecompose)->DenseRange(0, 2)->ArgName("scaling");
+
+static void BM_TransformInverse(benchmark::State &state) {
+    Scaling scaling = (Scaling)state.range(0);
+    std::vector<Transform> transforms = random_transforms(1024, scaling);
+    check_against_matrices(transforms);
+    for (auto _ : state) {
+        for (const Transform &transform : transforms) {
+            Transform result = transform.inverse();
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * transforms.size());
+}
+BENCHMARK(BM_TransformInverse)->DenseRange(0, 2)->ArgName("scaling");
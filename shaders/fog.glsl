@@ -0,0 +1,17 @@
+float calculateFogFactor(vec2 tilePos, usampler2D fogOfWarTex) {
+    // Every texel holds one row of a 32 tile chunk, x is the visible bits
+    // and y the explored bits
+    ivec2 tile = ivec2(floor(tilePos));
+    ivec2 texel = clamp(ivec2(tile.x >> 5, tile.y), ivec2(0),
+                        textureSize(fogOfWarTex, 0) - 1);
+    uvec2 bits = texelFetch(fogOfWarTex, texel, 0).xy;
+    uint mask = 1u << uint(tile.x & 31);
+
+    if ((bits.x & mask) != 0u) {
+        return 1.0;
+    }
+    if ((bits.y & mask) != 0u) {
+        return 0.5;
+    }
+    return 0.15;
+}
@@ -12,6 +12,7 @@ layout(location = 3) in vec3 inInstanceColor;
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 outColor;
 layout(location = 2) out vec4 outPosLightSpace;
+layout(location = 3) out vec2 outTilePos;
 
 layout(push_constant) uniform constants {
     mat4 chunkModel;
@@ -25,4 +26,5 @@ void main() {
     outNormal = inNormal;
     outColor = inInstanceColor;
     outPosLightSpace = sceneData.lightViewproj * worldPos;
+    outTilePos = (PushConstants.chunkModel * worldPos).xz;
 }
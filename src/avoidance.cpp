@@ -0,0 +1,306 @@
+#include "avoidance.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+static constexpr float kEpsilon = 1e-5f;
+
+void AvoidanceAgents::clear() {
+    entities.clear();
+    positions.clear();
+    velocities.clear();
+    preferredVelocities.clear();
+    radii.clear();
+    maxSpeeds.clear();
+    newVelocities.clear();
+    agentIndices.clear();
+}
+
+void AvoidanceAgents::add(entt::entity entity, const glm::vec2 &position,
+                          const glm::vec2 &velocity,
+                          const glm::vec2 &preferredVelocity, float radius,
+                          float maxSpeed) {
+    agentIndices.set(entity, size());
+
+    entities.push_back(entity);
+    positions.push_back(position);
+    velocities.push_back(velocity);
+    preferredVelocities.push_back(preferredVelocity);
+    radii.push_back(radius);
+    maxSpeeds.push_back(maxSpeed);
+}
+
+uint32_t AvoidanceAgents::find(entt::entity entity) const {
+    const uint32_t *agent = agentIndices.find(entity);
+    return agent ? *agent : kInvalidAgent;
+}
+
+/// Velocities on the allowed side of the line satisfy det(direction,
+/// point - velocity) <= 0
+struct OrcaLine {
+    glm::vec2 point;
+    glm::vec2 direction;
+};
+
+using OrcaLines = std::array<OrcaLine, AVOIDANCE_MAX_NEIGHBORS>;
+
+static inline float det(const glm::vec2 &a, const glm::vec2 &b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+/**
+ * @brief Solves the 1D problem of finding the point on line lineNo closest to
+ *        the optimal velocity that satisfies all previous lines and the speed
+ *        limit. With directionOpt the optimal velocity is a direction to go as
+ *        far as possible along instead.
+ */
+static bool linear_program1(const OrcaLine *lines, uint32_t lineNo,
+                            float radius, const glm::vec2 &optVelocity,
+                            bool directionOpt, glm::vec2 &result) {
+    const OrcaLine &line = lines[lineNo];
+    float dotProduct = glm::dot(line.point, line.direction);
+    float discriminant = dotProduct * dotProduct + radius * radius -
+                         glm::dot(line.point, line.point);
+    if (discriminant < 0.f) {
+        // NOTE: The speed limit circle misses the line entirely
+        return false;
+    }
+
+    float sqrtDiscriminant = sqrtf(discriminant);
+    float tLeft = -dotProduct - sqrtDiscriminant;
+    float tRight = -dotProduct + sqrtDiscriminant;
+
+    for (uint32_t i = 0; i < lineNo; i++) {
+        float denominator = det(line.direction, lines[i].direction);
+        float numerator =
+            det(lines[i].direction, line.point - lines[i].point);
+
+        if (fabsf(denominator) <= kEpsilon) {
+            // NOTE: Parallel lines, either all or nothing is allowed
+            if (numerator < 0.f) {
+                return false;
+            }
+            continue;
+        }
+
+        float t = numerator / denominator;
+        if (denominator >= 0.f) {
+            tRight = std::min(tRight, t);
+        } else {
+            tLeft = std::max(tLeft, t);
+        }
+
+        if (tLeft > tRight) {
+            return false;
+        }
+    }
+
+    if (directionOpt) {
+        float t = glm::dot(optVelocity, line.direction) > 0.f ? tRight : tLeft;
+        result = line.point + t * line.direction;
+    } else {
+        float t = glm::dot(line.direction, optVelocity - line.point);
+        result = line.point + std::clamp(t, tLeft, tRight) * line.direction;
+    }
+    return true;
+}
+
+/**
+ * @brief Incremental 2D linear program. Returns the number of lines it got
+ *        through, which is lineCount on success or the first line that could
+ *        not be satisfied.
+ */
+static uint32_t linear_program2(const OrcaLine *lines, uint32_t lineCount,
+                                float radius, const glm::vec2 &optVelocity,
+                                bool directionOpt, glm::vec2 &result) {
+    if (directionOpt) {
+        // NOTE: optVelocity is a unit vector here
+        result = optVelocity * radius;
+    } else if (glm::dot(optVelocity, optVelocity) > radius * radius) {
+        result = glm::normalize(optVelocity) * radius;
+    } else {
+        result = optVelocity;
+    }
+
+    for (uint32_t i = 0; i < lineCount; i++) {
+        if (det(lines[i].direction, lines[i].point - result) > 0.f) {
+            glm::vec2 previousResult = result;
+            if (!linear_program1(lines, i, radius, optVelocity, directionOpt,
+                                 result)) {
+                result = previousResult;
+                return i;
+            }
+        }
+    }
+    return lineCount;
+}
+
+/**
+ * @brief Fallback when the constraints are infeasible, usually because agents
+ *        already overlap. Finds the velocity that violates the lines starting
+ *        at beginLine by the smallest maximum distance.
+ */
+static void linear_program3(const OrcaLine *lines, uint32_t lineCount,
+                            uint32_t beginLine, float radius,
+                            glm::vec2 &result) {
+    float distance = 0.f;
+    OrcaLines projectedLines;
+
+    for (uint32_t i = beginLine; i < lineCount; i++) {
+        if (det(lines[i].direction, lines[i].point - result) <= distance) {
+            continue;
+        }
+
+        uint32_t projectedCount = 0;
+        for (uint32_t j = 0; j < i; j++) {
+            OrcaLine line;
+            float determinant = det(lines[i].direction, lines[j].direction);
+            if (fabsf(determinant) <= kEpsilon) {
+                if (glm::dot(lines[i].direction, lines[j].direction) > 0.f) {
+                    // NOTE: Same direction, line i is the stricter one
+                    continue;
+                }
+                line.point = 0.5f * (lines[i].point + lines[j].point);
+            } else {
+                line.point = lines[i].point +
+                             (det(lines[j].direction,
+                                  lines[i].point - lines[j].point) /
+                              determinant) *
+                                 lines[i].direction;
+            }
+            line.direction =
+                glm::normalize(lines[j].direction - lines[i].direction);
+            projectedLines[projectedCount++] = line;
+        }
+
+        glm::vec2 previousResult = result;
+        glm::vec2 direction{-lines[i].direction.y, lines[i].direction.x};
+        if (linear_program2(projectedLines.data(), projectedCount, radius,
+                            direction, true, result) < projectedCount) {
+            // NOTE: Can only fail because of floating point error, the
+            // previous result is as good as it gets then
+            result = previousResult;
+        }
+        distance = det(lines[i].direction, lines[i].point - result);
+    }
+}
+
+static OrcaLine orca_line(const AvoidanceAgents &agents, uint32_t self,
+                          uint32_t other, float invTimeHorizon,
+                          float invTimeStep) {
+    glm::vec2 velocity = agents.velocities[self];
+    glm::vec2 relativePosition =
+        agents.positions[other] - agents.positions[self];
+    glm::vec2 relativeVelocity = velocity - agents.velocities[other];
+    float distanceSq = glm::dot(relativePosition, relativePosition);
+    float combinedRadius = agents.radii[self] + agents.radii[other];
+    float combinedRadiusSq = combinedRadius * combinedRadius;
+
+    OrcaLine line;
+    glm::vec2 u;
+
+    if (distanceSq > combinedRadiusSq) {
+        // NOTE: Vector from the cutoff circle center to the relative velocity
+        glm::vec2 w = relativeVelocity - invTimeHorizon * relativePosition;
+        float wLengthSq = glm::dot(w, w);
+        float dotProduct = glm::dot(w, relativePosition);
+
+        if (dotProduct < 0.f &&
+            dotProduct * dotProduct > combinedRadiusSq * wLengthSq) {
+            // NOTE: Project on the cutoff circle
+            float wLength = sqrtf(wLengthSq);
+            glm::vec2 unitW = w / wLength;
+            line.direction = glm::vec2(unitW.y, -unitW.x);
+            u = (combinedRadius * invTimeHorizon - wLength) * unitW;
+        } else {
+            // NOTE: Project on the closer leg of the velocity obstacle
+            float leg = sqrtf(distanceSq - combinedRadiusSq);
+            if (det(relativePosition, w) > 0.f) {
+                line.direction =
+                    glm::vec2(relativePosition.x * leg -
+                                  relativePosition.y * combinedRadius,
+                              relativePosition.x * combinedRadius +
+                                  relativePosition.y * leg) /
+                    distanceSq;
+            } else {
+                line.direction =
+                    -glm::vec2(relativePosition.x * leg +
+                                   relativePosition.y * combinedRadius,
+                               -relativePosition.x * combinedRadius +
+                                   relativePosition.y * leg) /
+                    distanceSq;
+            }
+            u = glm::dot(relativeVelocity, line.direction) * line.direction -
+                relativeVelocity;
+        }
+    } else {
+        // NOTE: Already overlapping, so get apart within this step
+        glm::vec2 w = relativeVelocity - invTimeStep * relativePosition;
+        float wLength = glm::length(w);
+        glm::vec2 unitW;
+        if (wLength > kEpsilon) {
+            unitW = w / wLength;
+        } else {
+            // NOTE: Same position and velocity, push the two agents apart in
+            // opposite directions
+            unitW = glm::vec2(
+                entt::to_integral(agents.entities[self]) <
+                        entt::to_integral(agents.entities[other])
+                    ? -1.f
+                    : 1.f,
+                0.f);
+        }
+        line.direction = glm::vec2(unitW.y, -unitW.x);
+        u = (combinedRadius * invTimeStep - wLength) * unitW;
+    }
+
+    // NOTE: Both agents take half of the responsibility to avoid each other
+    line.point = velocity + 0.5f * u;
+    return line;
+}
+
+void compute_avoidance_velocities(AvoidanceAgents &agents,
+                                  const SpatialGrid &grid,
+                                  const AvoidanceParams &params, float dt,
+                                  JobSystem &jobs) {
+    assert(params.maxNeighbors <= AVOIDANCE_MAX_NEIGHBORS);
+    agents.newVelocities.resize(agents.size());
+
+    float invTimeHorizon = 1.f / params.timeHorizon;
+    float invTimeStep = 1.f / dt;
+
+    auto solve = [&agents, &grid, &params, invTimeHorizon,
+                  invTimeStep](uint32_t begin, uint32_t end) {
+        static thread_local std::vector<entt::entity> neighbors;
+        OrcaLines lines;
+
+        for (uint32_t i = begin; i < end; i++) {
+            neighbors.clear();
+            grid.query_k_nearest(agents.positions[i], params.maxNeighbors,
+                                 neighbors, params.neighborDistance,
+                                 agents.entities[i]);
+
+            uint32_t lineCount = 0;
+            for (entt::entity neighbor : neighbors) {
+                uint32_t neighborAgent = agents.find(neighbor);
+                if (neighborAgent == kInvalidAgent) {
+                    continue;
+                }
+                lines[lineCount++] = orca_line(agents, i, neighborAgent,
+                                               invTimeHorizon, invTimeStep);
+            }
+
+            glm::vec2 result;
+            uint32_t lineFail = linear_program2(
+                lines.data(), lineCount, agents.maxSpeeds[i],
+                agents.preferredVelocities[i], false, result);
+            if (lineFail < lineCount) {
+                linear_program3(lines.data(), lineCount, lineFail,
+                                agents.maxSpeeds[i], result);
+            }
+            agents.newVelocities[i] = result;
+        }
+    };
+
+    jobs.parallel_for(agents.size(), 64, solve, "avoidance");
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "entity_slot_map.h"
+#include "parallel.h"
+#include "spatial_grid.h"
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+#define AVOIDANCE_MAX_NEIGHBORS 10
+
+static constexpr uint32_t kInvalidAgent = UINT32_MAX;
+
+struct AvoidanceParams {
+    /// How far ahead, in seconds, collisions with other agents are avoided
+    float timeHorizon{2.f};
+    float neighborDistance{4.f};
+    /// Only the closest neighbors are considered, so the cost per agent is
+    /// bounded no matter how crowded it gets
+    uint32_t maxNeighbors{AVOIDANCE_MAX_NEIGHBORS};
+};
+
+/// Agents taking part in one avoidance step, one array per field. Positions
+/// and velocities are on the ground plane, x being world x and y world z.
+struct AvoidanceAgents {
+    std::vector<entt::entity> entities;
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec2> velocities;
+    std::vector<glm::vec2> preferredVelocities;
+    std::vector<float> radii;
+    std::vector<float> maxSpeeds;
+    /// Output of compute_avoidance_velocities
+    std::vector<glm::vec2> newVelocities;
+
+    EntitySlotMap<uint32_t> agentIndices;
+
+    void clear();
+    void add(entt::entity entity, const glm::vec2 &position,
+             const glm::vec2 &velocity, const glm::vec2 &preferredVelocity,
+             float radius, float maxSpeed);
+    /// Index of the entity's agent, or kInvalidAgent if it has none
+    uint32_t find(entt::entity entity) const;
+    uint32_t size() const { return (uint32_t)entities.size(); }
+};
+
+/// Picks for every agent the velocity closest to its preferred one that stays
+/// out of the ORCA half-planes of its nearest neighbors. Neighbors are looked
+/// up in the grid, which has to hold every agent. Each agent only reads the
+/// state from before the step, so the result does not depend on how the
+/// agents are split between threads.
+void compute_avoidance_velocities(AvoidanceAgents &agents,
+                                  const SpatialGrid &grid,
+                                  const AvoidanceParams &params, float dt,
+                                  JobSystem &jobs);
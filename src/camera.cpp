@@ -7,18 +7,18 @@ Camera::Camera(InputManager &input) : _input(input) {}
 
 void Camera::update(float dt) {
     glm::vec2 mousePos = _input.mousePos();
-    if (mousePos.x > _screenWidth - 50.f) {
+    if (mousePos.x > _screenWidth - 50.f || _input.is_active(PAN_RIGHT)) {
         _position.x += dt * kPanSpeed;
         _isDirty = true;
-    } else if (mousePos.x < 50.f) {
+    } else if (mousePos.x < 50.f || _input.is_active(PAN_LEFT)) {
         _position.x -= dt * kPanSpeed;
         _isDirty = true;
     }
 
-    if (mousePos.y > _screenHeight - 50.f) {
+    if (mousePos.y > _screenHeight - 50.f || _input.is_active(PAN_DOWN)) {
         _position.z += dt * kPanSpeed;
         _isDirty = true;
-    } else if (mousePos.y < 50.f) {
+    } else if (mousePos.y < 50.f || _input.is_active(PAN_UP)) {
         _position.z -= dt * kPanSpeed;
         _isDirty = true;
     }
@@ -12,6 +12,9 @@ class Camera {
     glm::mat4 get_projection_matrix();
 
     void set_screen_dimensions(float width, float height);
+    glm::vec2 screen_dimensions() const {
+        return glm::vec2(_screenWidth, _screenHeight);
+    }
 
     void update(float dt);
 
@@ -0,0 +1,369 @@
+#include "collision.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <xmmintrin.h>
+
+void SweepAndPrune::clear() {
+    _intervals.clear();
+    _slots.clear();
+    _insertedSinceSort = 0;
+}
+
+void SweepAndPrune::insert(entt::entity entity, const glm::vec2 &min,
+                           const glm::vec2 &max) {
+    assert(!contains(entity));
+
+    // NOTE: Appended out of order, the next sort moves it into place
+    _slots.set(entity, (uint32_t)_intervals.size());
+    _intervals.push_back(Interval{min.x, max.x, min.y, max.y, entity});
+    _insertedSinceSort++;
+}
+
+void SweepAndPrune::remove(entt::entity entity) {
+    assert(contains(entity));
+    uint32_t slot = *_slots.find(entity);
+    _intervals.erase(_intervals.begin() + slot);
+    for (uint32_t i = slot; i < _intervals.size(); i++) {
+        _slots.set(_intervals[i].entity, i);
+    }
+    _slots.erase(entity);
+}
+
+void SweepAndPrune::update(entt::entity entity, const glm::vec2 &min,
+                           const glm::vec2 &max) {
+    assert(contains(entity));
+    Interval &interval = _intervals[*_slots.find(entity)];
+    interval.minX = min.x;
+    interval.maxX = max.x;
+    interval.minY = min.y;
+    interval.maxY = max.y;
+}
+
+bool SweepAndPrune::contains(entt::entity entity) const {
+    return _slots.contains(entity);
+}
+
+void SweepAndPrune::sort() {
+    if (_insertedSinceSort > 64) {
+        std::sort(_intervals.begin(), _intervals.end(),
+                  [](const Interval &a, const Interval &b) {
+                      if (a.minX != b.minX) {
+                          return a.minX < b.minX;
+                      }
+                      return entt::to_integral(a.entity) <
+                             entt::to_integral(b.entity);
+                  });
+        for (uint32_t i = 0; i < _intervals.size(); i++) {
+            _slots.set(_intervals[i].entity, i);
+        }
+        _insertedSinceSort = 0;
+        return;
+    }
+    _insertedSinceSort = 0;
+
+    for (uint32_t i = 1; i < _intervals.size(); i++) {
+        if (_intervals[i - 1].minX <= _intervals[i].minX) {
+            continue;
+        }
+
+        Interval interval = _intervals[i];
+        uint32_t j = i;
+        while (j > 0 && _intervals[j - 1].minX > interval.minX) {
+            _intervals[j] = _intervals[j - 1];
+            _slots.set(_intervals[j].entity, j);
+            j--;
+        }
+        _intervals[j] = interval;
+        _slots.set(interval.entity, j);
+    }
+}
+
+void SweepAndPrune::find_pairs(std::vector<CollisionPair> &out) {
+    sort();
+
+    uint32_t count = (uint32_t)_intervals.size();
+    // NOTE: Padding boxes start at infinity, so they end every sweep, and
+    // there are enough of them that a load of 4 never runs off the end
+    uint32_t paddedCount = count + 3;
+    _sweepMinX.resize(paddedCount);
+    _sweepMinY.resize(paddedCount);
+    _sweepMaxY.resize(paddedCount);
+    for (uint32_t i = 0; i < count; i++) {
+        _sweepMinX[i] = _intervals[i].minX;
+        _sweepMinY[i] = _intervals[i].minY;
+        _sweepMaxY[i] = _intervals[i].maxY;
+    }
+    for (uint32_t i = count; i < paddedCount; i++) {
+        _sweepMinX[i] = std::numeric_limits<float>::max();
+        _sweepMinY[i] = 0.f;
+        _sweepMaxY[i] = 0.f;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const Interval &a = _intervals[i];
+        __m128 aMaxX = _mm_set1_ps(a.maxX);
+        __m128 aMinY = _mm_set1_ps(a.minY);
+        __m128 aMaxY = _mm_set1_ps(a.maxY);
+
+        for (uint32_t j = i + 1; j < count; j += 4) {
+            __m128 inX = _mm_cmple_ps(_mm_loadu_ps(&_sweepMinX[j]), aMaxX);
+            __m128 inY =
+                _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&_sweepMinY[j]), aMaxY),
+                           _mm_cmple_ps(aMinY, _mm_loadu_ps(&_sweepMaxY[j])));
+
+            uint32_t overlaps = (uint32_t)_mm_movemask_ps(_mm_and_ps(inX, inY));
+            while (overlaps) {
+                uint32_t lane = (uint32_t)std::countr_zero(overlaps);
+                out.push_back(CollisionPair{a.entity,
+                                            _intervals[j + lane].entity});
+                overlaps &= overlaps - 1;
+            }
+
+            // NOTE: Everything further along starts after a ends
+            if (_mm_movemask_ps(inX) != 0xF) {
+                break;
+            }
+        }
+    }
+}
+
+bool resolve_circle_circle(glm::vec2 &a, float radiusA, glm::vec2 &b,
+                           float radiusB) {
+    glm::vec2 offset = b - a;
+    float distanceSq = glm::dot(offset, offset);
+    float reach = radiusA + radiusB;
+    if (distanceSq >= reach * reach) {
+        return false;
+    }
+
+    float distance = sqrtf(distanceSq);
+    // NOTE: Circles on top of each other get split along x
+    glm::vec2 normal =
+        distance > 1e-6f ? offset / distance : glm::vec2(1.f, 0.f);
+    float push = 0.5f * (reach - distance);
+    a -= normal * push;
+    b += normal * push;
+    return true;
+}
+
+/**
+ * @brief Slab test of a moving point against a box. A point that starts
+ *        inside hits at time 0 when it moves away from the nearest open face,
+ *        so being slightly inside a wall never lets a move pass through it.
+ *
+ * @param openFaces Faces at -x, +x, -y and +y that border free space. The
+ *        others touch another wall and are never hit.
+ */
+static bool sweep_point_box(const glm::vec2 &origin, const glm::vec2 &delta,
+                            const glm::vec2 &boxMin, const glm::vec2 &boxMax,
+                            const std::array<bool, 4> &openFaces,
+                            float &outTime, glm::vec2 &outNormal) {
+    float tEnter = std::numeric_limits<float>::lowest();
+    float tExit = std::numeric_limits<float>::max();
+    glm::vec2 normal{0.f};
+
+    for (int axis = 0; axis < 2; axis++) {
+        if (fabsf(delta[axis]) < 1e-8f) {
+            if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        float invDelta = 1.f / delta[axis];
+        float t1 = (boxMin[axis] - origin[axis]) * invDelta;
+        float t2 = (boxMax[axis] - origin[axis]) * invDelta;
+        if (t1 > t2) {
+            std::swap(t1, t2);
+        }
+
+        if (t1 > tEnter) {
+            tEnter = t1;
+            normal = glm::vec2(0.f);
+            normal[axis] = delta[axis] > 0.f ? -1.f : 1.f;
+        }
+        tExit = std::min(tExit, t2);
+        if (tEnter > tExit) {
+            return false;
+        }
+    }
+
+    if (tEnter > 1.f || tExit < 0.f) {
+        return false;
+    }
+
+    if (tEnter < 0.f) {
+        static constexpr float kClosed = std::numeric_limits<float>::max();
+        float faces[4] = {
+            openFaces[0] ? origin.x - boxMin.x : kClosed,
+            openFaces[1] ? boxMax.x - origin.x : kClosed,
+            openFaces[2] ? origin.y - boxMin.y : kClosed,
+            openFaces[3] ? boxMax.y - origin.y : kClosed,
+        };
+        int nearest = (int)(std::min_element(faces, faces + 4) - faces);
+        // NOTE: Buried in walls, only depenetration gets it out
+        if (faces[nearest] == kClosed) {
+            return false;
+        }
+        normal = glm::vec2(0.f);
+        normal[nearest / 2] = nearest % 2 == 0 ? -1.f : 1.f;
+        // NOTE: Moving out, or along the face, is left alone
+        if (glm::dot(delta, normal) >= 0.f) {
+            return false;
+        }
+        tEnter = 0.f;
+    } else {
+        // NOTE: Only a point inside the neighbouring wall enters through a
+        // closed face, and that wall already stops it
+        int face = normal.x != 0.f ? (normal.x < 0.f ? 0 : 1)
+                                   : (normal.y < 0.f ? 2 : 3);
+        if (!openFaces[face]) {
+            return false;
+        }
+    }
+
+    outTime = tEnter;
+    outNormal = normal;
+    return true;
+}
+
+glm::vec2 move_circle_against_tiles(TileMap *tm, const glm::vec2 &start,
+                                    const glm::vec2 &delta, float radius) {
+    // NOTE: Distance kept from walls after a hit, so the next sweep does not
+    // start touching the same wall
+    static constexpr float kSkin = 1e-3f;
+    static constexpr int kMaxIterations = 3;
+
+    glm::vec2 position = start;
+    glm::vec2 remaining = delta;
+
+    for (int iteration = 0; iteration < kMaxIterations; iteration++) {
+        if (glm::dot(remaining, remaining) <= 1e-12f) {
+            break;
+        }
+
+        glm::vec2 end = position + remaining;
+        glm::vec2 sweptMin = glm::min(position, end) - radius;
+        glm::vec2 sweptMax = glm::max(position, end) + radius;
+        int32_t minX = world_to_tile(tm, sweptMin.x);
+        int32_t minY = world_to_tile(tm, sweptMin.y);
+        int32_t maxX = world_to_tile(tm, sweptMax.x);
+        int32_t maxY = world_to_tile(tm, sweptMax.y);
+
+        float hitTime = 1.f;
+        glm::vec2 hitNormal{0.f};
+        for (int32_t y = minY; y <= maxY; y++) {
+            for (int32_t x = minX; x <= maxX; x++) {
+                if (is_tile_traversible(tm, x, y)) {
+                    continue;
+                }
+
+                // NOTE: Sweeping the center against the tile grown by the
+                // radius is slightly conservative around the corners
+                glm::vec2 tileMin =
+                    glm::vec2(tile_to_world(tm, x), tile_to_world(tm, y)) -
+                    radius;
+                glm::vec2 tileMax = glm::vec2(tile_to_world(tm, x + 1),
+                                              tile_to_world(tm, y + 1)) +
+                                    radius;
+                std::array<bool, 4> openFaces = {
+                    is_tile_traversible(tm, x - 1, y),
+                    is_tile_traversible(tm, x + 1, y),
+                    is_tile_traversible(tm, x, y - 1),
+                    is_tile_traversible(tm, x, y + 1),
+                };
+                float time;
+                glm::vec2 normal;
+                if (sweep_point_box(position, remaining, tileMin, tileMax,
+                                    openFaces, time, normal) &&
+                    time < hitTime) {
+                    hitTime = time;
+                    hitNormal = normal;
+                }
+            }
+        }
+
+        position += remaining * hitTime;
+        if (hitTime >= 1.f) {
+            break;
+        }
+
+        position += hitNormal * kSkin;
+        remaining *= 1.f - hitTime;
+        remaining -= glm::dot(remaining, hitNormal) * hitNormal;
+    }
+
+    return position;
+}
+
+glm::vec2 depenetrate_circle_from_tiles(TileMap *tm, const glm::vec2 &position,
+                                        float radius) {
+    static constexpr float kNoExit = std::numeric_limits<float>::max();
+    glm::vec2 result = position;
+
+    int32_t minX = world_to_tile(tm, position.x - radius);
+    int32_t minY = world_to_tile(tm, position.y - radius);
+    int32_t maxX = world_to_tile(tm, position.x + radius);
+    int32_t maxY = world_to_tile(tm, position.y + radius);
+
+    for (int32_t y = minY; y <= maxY; y++) {
+        for (int32_t x = minX; x <= maxX; x++) {
+            if (is_tile_traversible(tm, x, y)) {
+                continue;
+            }
+
+            glm::vec2 tileMin{tile_to_world(tm, x), tile_to_world(tm, y)};
+            glm::vec2 tileMax{tile_to_world(tm, x + 1),
+                              tile_to_world(tm, y + 1)};
+            glm::vec2 closest = glm::clamp(result, tileMin, tileMax);
+            glm::vec2 offset = result - closest;
+            float distanceSq = glm::dot(offset, offset);
+            if (distanceSq >= radius * radius) {
+                continue;
+            }
+
+            if (distanceSq > 1e-12f) {
+                float distance = sqrtf(distanceSq);
+                result += offset / distance * (radius - distance);
+                continue;
+            }
+
+            // NOTE: The center is inside the tile, leave through the nearest
+            // side that doesn't lead straight into another blocked tile
+            float exits[4] = {
+                is_tile_traversible(tm, x - 1, y) ? result.x - tileMin.x
+                                                  : kNoExit,
+                is_tile_traversible(tm, x + 1, y) ? tileMax.x - result.x
+                                                  : kNoExit,
+                is_tile_traversible(tm, x, y - 1) ? result.y - tileMin.y
+                                                  : kNoExit,
+                is_tile_traversible(tm, x, y + 1) ? tileMax.y - result.y
+                                                  : kNoExit,
+            };
+            int nearest = (int)(std::min_element(exits, exits + 4) - exits);
+            if (exits[nearest] == kNoExit) {
+                continue;
+            }
+
+            switch (nearest) {
+            case 0:
+                result.x = tileMin.x - radius;
+                break;
+            case 1:
+                result.x = tileMax.x + radius;
+                break;
+            case 2:
+                result.y = tileMin.y - radius;
+                break;
+            case 3:
+                result.y = tileMax.y + radius;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "entity_slot_map.h"
+#include "tile.h"
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct CollisionPair {
+    entt::entity a;
+    entt::entity b;
+};
+
+/// Broadphase over boxes on the ground plane kept sorted by their lower x
+/// bound. Units barely move between steps, so restoring the order with an
+/// insertion sort is close to linear, and the sweep only ever compares boxes
+/// whose x intervals overlap.
+class SweepAndPrune {
+  public:
+    void clear();
+
+    void insert(entt::entity entity, const glm::vec2 &min,
+                const glm::vec2 &max);
+    void remove(entt::entity entity);
+    /// Only stores the new bounds, the order is restored by find_pairs
+    void update(entt::entity entity, const glm::vec2 &min,
+                const glm::vec2 &max);
+    bool contains(entt::entity entity) const;
+    uint32_t size() const { return (uint32_t)_intervals.size(); }
+
+    /// Appends every pair of overlapping boxes, in sweep order
+    void find_pairs(std::vector<CollisionPair> &out);
+
+  private:
+    struct Interval {
+        float minX;
+        float maxX;
+        float minY;
+        float maxY;
+        entt::entity entity;
+    };
+
+    std::vector<Interval> _intervals;
+    EntitySlotMap<uint32_t> _slots;
+    // NOTE: Copy of the sorted bounds, one array per field so the sweep can
+    // test 4 boxes at a time
+    std::vector<float> _sweepMinX;
+    std::vector<float> _sweepMinY;
+    std::vector<float> _sweepMaxY;
+    // NOTE: Fresh boxes sit at the end in no particular order, so after many
+    // inserts a full sort beats the insertion sort
+    uint32_t _insertedSinceSort{0};
+
+    void sort();
+};
+
+/// Pushes two overlapping circles apart, each taking half of the overlap.
+/// Returns false if they don't touch.
+bool resolve_circle_circle(glm::vec2 &a, float radiusA, glm::vec2 &b,
+                           float radiusB);
+
+/// Moves a circle by delta, stopping at tiles that are not traversible and
+/// sliding along them with whatever movement is left
+glm::vec2 move_circle_against_tiles(TileMap *tm, const glm::vec2 &start,
+                                    const glm::vec2 &delta, float radius);
+/// Pushes the circle out of every blocked tile it overlaps
+glm::vec2 depenetrate_circle_from_tiles(TileMap *tm, const glm::vec2 &position,
+                                        float radius);
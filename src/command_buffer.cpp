@@ -0,0 +1,74 @@
+#include "command_buffer.h"
+
+CommandBuffer::ThreadCommands &CommandBuffer::local() {
+    // NOTE: Only the owning thread creates its slot, and playback never runs
+    // while anything records, so no lock is needed
+    std::unique_ptr<ThreadCommands> &thread =
+        _threads[JobSystem::current_thread()];
+    if (!thread) {
+        thread = std::make_unique<ThreadCommands>();
+    }
+    return *thread;
+}
+
+CommandBuffer::PendingEntity CommandBuffer::create() {
+    uint32_t thread = JobSystem::current_thread();
+    return PendingEntity{thread, local().createCount++};
+}
+
+void CommandBuffer::destroy(entt::entity entity) {
+    local().destroys.push_back(entity);
+}
+
+void CommandBuffer::play(entt::registry &registry) {
+    _typed.clear();
+    _destroys.clear();
+
+    for (uint32_t i = 0; i < _threads.size(); i++) {
+        ThreadCommands *thread = _threads[i].get();
+        if (!thread) {
+            continue;
+        }
+
+        _created[i].resize(thread->createCount);
+        registry.create(_created[i].begin(), _created[i].end());
+        thread->createCount = 0;
+
+        for (std::unique_ptr<ComponentCommandsBase> &commands :
+             thread->components) {
+            _typed.push_back(TypedCommands{commands->type, commands.get()});
+        }
+        _destroys.insert(_destroys.end(), thread->destroys.begin(),
+                         thread->destroys.end());
+        thread->destroys.clear();
+    }
+
+    std::sort(_typed.begin(), _typed.end(),
+              [](const TypedCommands &a, const TypedCommands &b) {
+                  return a.type < b.type;
+              });
+    for (size_t begin = 0; begin < _typed.size();) {
+        size_t end = begin;
+        _group.clear();
+        while (end < _typed.size() && _typed[end].type == _typed[begin].type) {
+            _group.push_back(_typed[end].commands);
+            end++;
+        }
+
+        _group[0]->play(registry, _group.data(), _group.size(), _created);
+        for (ComponentCommandsBase *commands : _group) {
+            commands->clear();
+        }
+        begin = end;
+    }
+
+    std::sort(_destroys.begin(), _destroys.end());
+    _destroys.erase(std::unique(_destroys.begin(), _destroys.end()),
+                    _destroys.end());
+    _destroys.erase(std::remove_if(_destroys.begin(), _destroys.end(),
+                                   [&registry](entt::entity entity) {
+                                       return !registry.valid(entity);
+                                   }),
+                    _destroys.end());
+    registry.destroy(_destroys.begin(), _destroys.end());
+}
@@ -0,0 +1,223 @@
+#pragma once
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <entt/entt.hpp>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/// Records structural changes to the registry while systems iterate it and
+/// applies them later in one go. Every thread records into its own buffer,
+/// so systems running on the job system never contend. Playback goes one
+/// component type at a time and uses the range versions of insert and
+/// remove.
+class CommandBuffer {
+  public:
+    /// An entity that only exists once the buffer is played back
+    struct PendingEntity {
+        uint32_t thread;
+        uint32_t index;
+    };
+
+    PendingEntity create();
+    void destroy(entt::entity entity);
+
+    /// Replaces the component if the entity already has one. When the same
+    /// component is emplaced twice on an entity, the last one recorded on
+    /// the same thread wins.
+    template <typename T> void emplace(entt::entity entity, T value = {});
+    template <typename T> void emplace(PendingEntity entity, T value = {});
+    template <typename T> void remove(entt::entity entity);
+    template <typename T, typename It> void remove(It first, It last);
+
+    /// Applies and clears everything recorded. Creates go first, then for
+    /// each component type its removes and then its emplaces, and destroys
+    /// go last. Must not run while anything records.
+    void play(entt::registry &registry);
+
+  private:
+    using CreatedEntities =
+        std::array<std::vector<entt::entity>, JobSystem::kMaxThreads>;
+
+    struct ComponentCommandsBase {
+        entt::id_type type;
+
+        virtual ~ComponentCommandsBase() = default;
+        /// Plays back the commands of every thread for this type at once
+        virtual void play(entt::registry &registry,
+                          ComponentCommandsBase *const *group, size_t count,
+                          const CreatedEntities &created) = 0;
+        virtual void clear() = 0;
+    };
+
+    template <typename T> struct ComponentCommands;
+
+    struct ThreadCommands {
+        uint32_t createCount{0};
+        std::vector<entt::entity> destroys;
+        std::vector<std::unique_ptr<ComponentCommandsBase>> components;
+    };
+
+    struct TypedCommands {
+        entt::id_type type;
+        ComponentCommandsBase *commands;
+    };
+
+    std::array<std::unique_ptr<ThreadCommands>, JobSystem::kMaxThreads>
+        _threads;
+    CreatedEntities _created;
+    // NOTE: Scratch for play, kept to reuse the capacity
+    std::vector<TypedCommands> _typed;
+    std::vector<ComponentCommandsBase *> _group;
+    std::vector<entt::entity> _destroys;
+
+    ThreadCommands &local();
+    template <typename T> ComponentCommands<T> &local_component();
+};
+
+template <typename T>
+struct CommandBuffer::ComponentCommands : ComponentCommandsBase {
+    static constexpr bool kIsEmpty = std::is_empty_v<T>;
+
+    std::vector<entt::entity> removes;
+    std::vector<entt::entity> emplaceEntities;
+    std::vector<T> emplaceValues;
+    std::vector<PendingEntity> pendingEntities;
+    std::vector<T> pendingValues;
+    // NOTE: Scratch for play, only used by the first commands of a group
+    std::vector<entt::entity> playEntities;
+    std::vector<T> playValues;
+    std::vector<uint32_t> playOrder;
+
+    void play(entt::registry &registry, ComponentCommandsBase *const *group,
+              size_t count, const CreatedEntities &created) override {
+        std::vector<entt::entity> &entities = playEntities;
+        std::vector<T> &values = playValues;
+
+        entities.clear();
+        for (size_t i = 0; i < count; i++) {
+            auto *commands = static_cast<ComponentCommands<T> *>(group[i]);
+            for (entt::entity entity : commands->removes) {
+                if (registry.valid(entity)) {
+                    entities.push_back(entity);
+                }
+            }
+        }
+        registry.remove<T>(entities.begin(), entities.end());
+
+        // NOTE: Entities that already have the component get it replaced,
+        // the rest are inserted together
+        auto &storage = registry.storage<T>();
+        entities.clear();
+        values.clear();
+        for (size_t i = 0; i < count; i++) {
+            auto *commands = static_cast<ComponentCommands<T> *>(group[i]);
+            for (size_t j = 0; j < commands->emplaceEntities.size(); j++) {
+                entt::entity entity = commands->emplaceEntities[j];
+                if (!registry.valid(entity)) {
+                    continue;
+                }
+                if (storage.contains(entity)) {
+                    if constexpr (!kIsEmpty) {
+                        registry.replace<T>(
+                            entity, std::move(commands->emplaceValues[j]));
+                    }
+                    continue;
+                }
+                entities.push_back(entity);
+                values.push_back(std::move(commands->emplaceValues[j]));
+            }
+            for (size_t j = 0; j < commands->pendingEntities.size(); j++) {
+                PendingEntity pending = commands->pendingEntities[j];
+                entities.push_back(created[pending.thread][pending.index]);
+                values.push_back(std::move(commands->pendingValues[j]));
+            }
+        }
+
+        // NOTE: Inserting an entity twice is not allowed, keep the last one
+        // recorded
+        std::vector<uint32_t> &order = playOrder;
+        order.resize(entities.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&entities](uint32_t a, uint32_t b) {
+                             return entities[a] < entities[b];
+                         });
+        size_t kept = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (i + 1 < order.size() &&
+                entities[order[i]] == entities[order[i + 1]]) {
+                continue;
+            }
+            order[kept++] = order[i];
+        }
+        order.resize(kept);
+        std::sort(order.begin(), order.end());
+        for (size_t i = 0; i < kept; i++) {
+            entities[i] = entities[order[i]];
+            values[i] = std::move(values[order[i]]);
+        }
+        entities.resize(kept);
+        values.resize(kept);
+
+        if constexpr (kIsEmpty) {
+            registry.insert<T>(entities.begin(), entities.end());
+        } else {
+            registry.insert<T>(entities.begin(), entities.end(),
+                               values.begin());
+        }
+    }
+
+    void clear() override {
+        removes.clear();
+        emplaceEntities.clear();
+        emplaceValues.clear();
+        pendingEntities.clear();
+        pendingValues.clear();
+    }
+};
+
+template <typename T>
+CommandBuffer::ComponentCommands<T> &CommandBuffer::local_component() {
+    ThreadCommands &thread = local();
+    entt::id_type type = entt::type_hash<T>::value();
+    for (std::unique_ptr<ComponentCommandsBase> &commands :
+         thread.components) {
+        if (commands->type == type) {
+            return static_cast<ComponentCommands<T> &>(*commands);
+        }
+    }
+
+    auto commands = std::make_unique<ComponentCommands<T>>();
+    commands->type = type;
+    ComponentCommands<T> &result = *commands;
+    thread.components.push_back(std::move(commands));
+    return result;
+}
+
+template <typename T>
+void CommandBuffer::emplace(entt::entity entity, T value) {
+    ComponentCommands<T> &commands = local_component<T>();
+    commands.emplaceEntities.push_back(entity);
+    commands.emplaceValues.push_back(std::move(value));
+}
+
+template <typename T>
+void CommandBuffer::emplace(PendingEntity entity, T value) {
+    ComponentCommands<T> &commands = local_component<T>();
+    commands.pendingEntities.push_back(entity);
+    commands.pendingValues.push_back(std::move(value));
+}
+
+template <typename T> void CommandBuffer::remove(entt::entity entity) {
+    local_component<T>().removes.push_back(entity);
+}
+
+template <typename T, typename It>
+void CommandBuffer::remove(It first, It last) {
+    std::vector<entt::entity> &removes = local_component<T>().removes;
+    removes.insert(removes.end(), first, last);
+}
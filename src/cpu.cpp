@@ -0,0 +1,28 @@
+#include "cpu.h"
+
+static SimdLevel detect_simd_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::kAVX2;
+    }
+    return SimdLevel::kSSE2;
+}
+
+static const SimdLevel supportedLevel = detect_simd_level();
+static SimdLevel selectedLevel = supportedLevel;
+
+SimdLevel simd_level() { return selectedLevel; }
+
+void force_simd_level(SimdLevel level) {
+    selectedLevel = level < supportedLevel ? level : supportedLevel;
+}
+
+const char *simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::kSSE2:
+        return "SSE2";
+    case SimdLevel::kAVX2:
+        return "AVX2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/// Widest instruction set the SIMD kernels use on this machine. The binary
+/// targets baseline x86-64, and kernels with a wider version check this at
+/// run time to pick it.
+enum class SimdLevel {
+    kSSE2,
+    kAVX2,
+};
+
+// NOTE: Functions marked with this may use AVX2 intrinsics, and must only be
+// called once simd_level() says the CPU has them
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+
+SimdLevel simd_level();
+/// Caps the level, e.g. to compare paths in benchmarks. Levels the CPU does
+/// not support are ignored.
+void force_simd_level(SimdLevel level);
+const char *simd_level_name(SimdLevel level);
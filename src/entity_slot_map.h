@@ -0,0 +1,47 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <vector>
+
+/// Maps entities to a value, usually where they sit in some dense array.
+/// Indexed by entity index, and every entry keeps the full versioned
+/// identifier, so an index recycled for another entity is never found.
+template <typename T> class EntitySlotMap {
+  public:
+    /// Null if the entity has no value
+    T *find(entt::entity entity) {
+        uint32_t index = entt::to_entity(entity);
+        if (index >= _entries.size() || _entries[index].entity != entity) {
+            return nullptr;
+        }
+        return &_entries[index].value;
+    }
+    const T *find(entt::entity entity) const {
+        return const_cast<EntitySlotMap *>(this)->find(entity);
+    }
+    bool contains(entt::entity entity) const { return find(entity); }
+
+    void set(entt::entity entity, const T &value) {
+        uint32_t index = entt::to_entity(entity);
+        if (index >= _entries.size()) {
+            _entries.resize(index + 1);
+        }
+        _entries[index] = Entry{entity, value};
+    }
+    void erase(entt::entity entity) {
+        assert(contains(entity));
+        _entries[entt::to_entity(entity)].entity = entt::null;
+    }
+    /// Forgets every entity but keeps the capacity
+    void clear() { std::fill(_entries.begin(), _entries.end(), Entry{}); }
+
+  private:
+    struct Entry {
+        entt::entity entity{entt::null};
+        T value{};
+    };
+
+    std::vector<Entry> _entries;
+};
@@ -0,0 +1,152 @@
+#include "fog.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+FogOfWar *create_fog_of_war(Arena *arena, TileMap *tm, uint32_t team_count) {
+    // NOTE: Every texel holds exactly one chunk row, so a chunk row has to fit
+    // in 32 bits
+    assert(tm->chunk_dim == 32);
+
+    FogOfWar *fog = push_size<FogOfWar>(arena);
+    fog->width = tm->n_tile_chunk_x * tm->chunk_dim;
+    fog->height = tm->n_tile_chunk_y * tm->chunk_dim;
+    fog->texels_per_row = tm->n_tile_chunk_x;
+    fog->team_count = team_count;
+
+    size_t tile_count = (size_t)fog->width * fog->height;
+    size_t texel_count = (size_t)fog->texels_per_row * fog->height;
+
+    fog->teams = push_array<FogTeam>(arena, team_count);
+    for (uint32_t i = 0; i < team_count; i++) {
+        FogTeam *team = &fog->teams[i];
+        team->sight_counts = push_array<uint16_t>(arena, tile_count);
+        memset(team->sight_counts, 0, tile_count * sizeof(uint16_t));
+        team->texels = push_array<FogTexel>(arena, texel_count);
+        memset(team->texels, 0, texel_count * sizeof(FogTexel));
+        team->has_dirty_rows = false;
+        team->texture_dirty = true;
+    }
+
+    uint32_t circle_rows = 0;
+    for (uint32_t r = 0; r <= FOG_MAX_SIGHT_RADIUS; r++) {
+        fog->circle_offsets[r] = circle_rows;
+        circle_rows += 2 * r + 1;
+    }
+
+    fog->circle_half_widths = push_array<uint8_t>(arena, circle_rows);
+    for (uint32_t r = 0; r <= FOG_MAX_SIGHT_RADIUS; r++) {
+        // NOTE: Measure against tile centers with half a tile of slack, so a
+        // radius of 1 gives a plus shape instead of a single tile
+        float outer = (float)r + 0.5f;
+        for (int32_t dy = -(int32_t)r; dy <= (int32_t)r; dy++) {
+            float half_width = sqrtf(outer * outer - (float)(dy * dy));
+            fog->circle_half_widths[fog->circle_offsets[r] + r + dy] =
+                (uint8_t)std::min(floorf(half_width), (float)r);
+        }
+    }
+
+    return fog;
+}
+
+static inline void add_to_span(uint16_t *counts, int32_t count,
+                               int16_t delta) {
+    __m128i d = _mm_set1_epi16(delta);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i *p = (__m128i *)(counts + i);
+        _mm_storeu_si128(p, _mm_add_epi16(_mm_loadu_si128(p), d));
+    }
+    for (; i < count; i++) {
+        counts[i] += delta;
+    }
+}
+
+static void stamp_circle(FogOfWar *fog, uint32_t team_index, int32_t tile_x,
+                         int32_t tile_y, uint32_t radius, int16_t delta) {
+    assert(team_index < fog->team_count);
+    FogTeam *team = &fog->teams[team_index];
+    int32_t r = (int32_t)std::min(radius, (uint32_t)FOG_MAX_SIGHT_RADIUS);
+    const uint8_t *half_widths =
+        &fog->circle_half_widths[fog->circle_offsets[r]];
+
+    int32_t y_min = std::max(tile_y - r, 0);
+    int32_t y_max = std::min(tile_y + r, (int32_t)fog->height - 1);
+    if (y_min > y_max) {
+        return;
+    }
+
+    for (int32_t y = y_min; y <= y_max; y++) {
+        int32_t half_width = half_widths[y - tile_y + r];
+        int32_t x_min = std::max(tile_x - half_width, 0);
+        int32_t x_max = std::min(tile_x + half_width, (int32_t)fog->width - 1);
+        if (x_min > x_max) {
+            continue;
+        }
+        add_to_span(&team->sight_counts[(size_t)y * fog->width + x_min],
+                    x_max - x_min + 1, delta);
+    }
+
+    if (team->has_dirty_rows) {
+        team->dirty_row_min = std::min(team->dirty_row_min, (uint32_t)y_min);
+        team->dirty_row_max = std::max(team->dirty_row_max, (uint32_t)y_max);
+    } else {
+        team->dirty_row_min = (uint32_t)y_min;
+        team->dirty_row_max = (uint32_t)y_max;
+        team->has_dirty_rows = true;
+    }
+}
+
+void fog_add_viewer(FogOfWar *fog, uint32_t team, int32_t tile_x,
+                    int32_t tile_y, uint32_t radius) {
+    stamp_circle(fog, team, tile_x, tile_y, radius, 1);
+}
+
+void fog_remove_viewer(FogOfWar *fog, uint32_t team, int32_t tile_x,
+                       int32_t tile_y, uint32_t radius) {
+    stamp_circle(fog, team, tile_x, tile_y, radius, -1);
+}
+
+/// Packs 32 sight counts into a visibility mask, one bit per non-zero count
+static inline uint32_t visible_mask(const uint16_t *counts) {
+    // NOTE: Counts are compared as signed, which is fine as long as fewer than
+    // 32768 viewers of a single team overlap on one tile
+    __m128i zero = _mm_setzero_si128();
+    __m128i c0 = _mm_loadu_si128((const __m128i *)(counts + 0));
+    __m128i c1 = _mm_loadu_si128((const __m128i *)(counts + 8));
+    __m128i c2 = _mm_loadu_si128((const __m128i *)(counts + 16));
+    __m128i c3 = _mm_loadu_si128((const __m128i *)(counts + 24));
+    __m128i lo = _mm_packs_epi16(_mm_cmpgt_epi16(c0, zero),
+                                 _mm_cmpgt_epi16(c1, zero));
+    __m128i hi = _mm_packs_epi16(_mm_cmpgt_epi16(c2, zero),
+                                 _mm_cmpgt_epi16(c3, zero));
+    return (uint32_t)_mm_movemask_epi8(lo) |
+           ((uint32_t)_mm_movemask_epi8(hi) << 16);
+}
+
+void fog_resolve(FogOfWar *fog) {
+    for (uint32_t t = 0; t < fog->team_count; t++) {
+        FogTeam *team = &fog->teams[t];
+        if (!team->has_dirty_rows) {
+            continue;
+        }
+
+        for (uint32_t y = team->dirty_row_min; y <= team->dirty_row_max; y++) {
+            const uint16_t *row = &team->sight_counts[(size_t)y * fog->width];
+            FogTexel *texels = &team->texels[(size_t)y * fog->texels_per_row];
+            for (uint32_t i = 0; i < fog->texels_per_row; i++) {
+                uint32_t visible = visible_mask(row + i * 32);
+                if (visible != texels[i].visible ||
+                    (visible & ~texels[i].explored)) {
+                    texels[i].visible = visible;
+                    texels[i].explored |= visible;
+                    team->texture_dirty = true;
+                }
+            }
+        }
+
+        team->has_dirty_rows = false;
+    }
+}
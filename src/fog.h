@@ -0,0 +1,64 @@
+#pragma once
+#include "memory.h"
+#include "tile.h"
+#include <cassert>
+#include <cstdint>
+
+// NOTE: Sight radii are in tiles, anything larger gets clamped to this
+#define FOG_MAX_SIGHT_RADIUS 16
+
+/// One texel of the fog of war texture, covering one row of a tile chunk.
+/// Bit x of a texel at (chunk_x, tile_y) is the tile
+/// (chunk_x * chunk_dim + x, tile_y).
+struct FogTexel {
+    uint32_t visible;
+    uint32_t explored;
+};
+
+struct FogTeam {
+    // NOTE: Number of viewers that currently see each tile, in row-major tile
+    // order. A viewer that moves only removes its old footprint and adds its
+    // new one, nothing is rebuilt from scratch.
+    uint16_t *sight_counts;
+    FogTexel *texels;
+
+    uint32_t dirty_row_min;
+    uint32_t dirty_row_max;
+    bool has_dirty_rows;
+
+    // NOTE: Set whenever a texel changes, cleared by whoever uploads it
+    bool texture_dirty;
+};
+
+struct FogOfWar {
+    uint32_t width;
+    uint32_t height;
+    uint32_t texels_per_row;
+
+    uint32_t team_count;
+    FogTeam *teams;
+
+    // NOTE: Half width of every row of a circle with a given radius, starting
+    // at circle_offsets[radius] for the topmost row
+    uint8_t *circle_half_widths;
+    uint32_t circle_offsets[FOG_MAX_SIGHT_RADIUS + 1];
+};
+
+FogOfWar *create_fog_of_war(Arena *arena, TileMap *tm, uint32_t team_count);
+void fog_add_viewer(FogOfWar *fog, uint32_t team, int32_t tile_x,
+                    int32_t tile_y, uint32_t radius);
+void fog_remove_viewer(FogOfWar *fog, uint32_t team, int32_t tile_x,
+                       int32_t tile_y, uint32_t radius);
+void fog_resolve(FogOfWar *fog);
+
+inline bool fog_is_tile_visible(FogOfWar *fog, uint32_t team, uint32_t tile_x,
+                                uint32_t tile_y) {
+    assert(team < fog->team_count);
+    if (tile_x >= fog->width || tile_y >= fog->height) {
+        return false;
+    }
+    const FogTexel &texel =
+        fog->teams[team]
+            .texels[tile_y * fog->texels_per_row + (tile_x >> 5)];
+    return (texel.visible >> (tile_x & 31)) & 1;
+}
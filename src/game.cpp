@@ -1,229 +1,1062 @@
 #include "game.h"
-#include <imgui_impl_sdl3.h>
+#include <algorithm>
+#include <thread>
 
-Uint64 TIMESTEP_MS = 1000 / 60;
-float TIMESTEP_S = (float)TIMESTEP_MS / 1000;
+Uint64 TIMESTEP_NS = SDL_NS_PER_SECOND / 60;
+float TIMESTEP_S = (float)TIMESTEP_NS / SDL_NS_PER_SECOND;
+// NOTE: Most ticks a frame runs to catch up after a stall
+uint32_t MAX_CATCH_UP_TICKS = 5;
+// NOTE: Sleeping can overshoot by a millisecond or more, so the end of a
+// wait is spun instead
+Uint64 SPIN_MARGIN_NS = 2 * SDL_NS_PER_MS;
 
-const std::unordered_map<UnitType, UnitData> UnitData::registry = {
-    {UnitType::kCube, {"Cube", 2.f}},
-};
+/// Sleeps until shortly before the deadline, then spins until it
+static void wait_until(Uint64 deadline) {
+    Uint64 now = SDL_GetTicksNS();
+    if (now + SPIN_MARGIN_NS < deadline) {
+        SDL_DelayNS(deadline - now - SPIN_MARGIN_NS);
+    }
+    while (SDL_GetTicksNS() < deadline) {
+        SDL_CPUPauseInstruction();
+    }
+}
+
+static void print_percentiles(const char *label,
+                              const TimingPercentiles &p, FILE *out) {
+    fprintf(out, "%-10s p50 %.2f p95 %.2f p99 %.2f max %.2f ms\n", label,
+            (double)p.p50 / 1e6, (double)p.p95 / 1e6, (double)p.p99 / 1e6,
+            (double)p.max / 1e6);
+}
 
 Game::Game() : _camera(_input) {}
 
-void Game::init() {
-    if (!SDL_Init(SDL_INIT_VIDEO)) {
-        fprintf(stderr, "could not initialize sdl3: %s\n", SDL_GetError());
-        abort();
+void Game::init(const GameConfig &config) {
+    _config = config;
+    _isScenario = _config.headless;
+    if (!_config.replayPath.empty()) {
+        if (!_replay.load(_config.replayPath.c_str())) {
+            abort();
+        }
+        const ReplayHeader &header = _replay.header();
+        _isReplaying = true;
+        _isScenario = header.isScenario;
+        _config.ticks = _replay.tick_count();
+        _config.scenario.mapChunks = header.mapChunks;
+        _config.scenario.entityCount = header.entityCount;
+        _config.scenario.orders = (OrderPattern)header.orders;
+        _config.scenario.orderInterval = header.orderInterval;
+        _config.scenario.seed = header.seed;
     }
 
-    _window = SDL_CreateWindow("hello_sdl3", SCREEN_WIDTH, SCREEN_HEIGHT,
-                               SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-    if (_window == NULL) {
-        fprintf(stderr, "could not create window: %s\n", SDL_GetError());
-        abort();
-    }
+    if (!_config.headless) {
+        if (!SDL_Init(SDL_INIT_VIDEO)) {
+            fprintf(stderr, "could not initialize sdl3: %s\n", SDL_GetError());
+            abort();
+        }
+
+        _window = SDL_CreateWindow("hello_sdl3", SCREEN_WIDTH, SCREEN_HEIGHT,
+                                   SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+        if (_window == NULL) {
+            fprintf(stderr, "could not create window: %s\n", SDL_GetError());
+            abort();
+        }
 
-    _camera.set_screen_dimensions((float)SCREEN_WIDTH, (float)SCREEN_HEIGHT);
+        _camera.set_screen_dimensions((float)SCREEN_WIDTH,
+                                      (float)SCREEN_HEIGHT);
 
-    _renderer.init(_window);
-    _renderer.set_camera_view(_camera.get_view_matrix());
-    _renderer.set_camera_projection(_camera.get_projection_matrix());
+        // NOTE: Anywhere near an edge pans the camera, so a mouse outside
+        // the window counts as being in the middle of it
+        glm::vec2 mousePos(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+        if (SDL_GetMouseFocus() == _window) {
+            SDL_GetMouseState(&mousePos.x, &mousePos.y);
+        }
+        _input.set_mouse_position(mousePos);
+
+        _renderer.init(_window, _config.renderer);
+    }
 
     void *memory = malloc(GAME_MEMORY);
     arena_init(&_arena, GAME_MEMORY, (uint8_t *)memory);
 
-    _world = generate_world(&_arena);
-    _renderer.update_tile_draw_commands(create_tile_map_mesh(_world->tile_map));
+    uint32_t mapChunks = _isScenario ? _config.scenario.mapChunks : 2;
+    _world = generate_world(&_arena, mapChunks, mapChunks);
+    _fog = create_fog_of_war(&_arena, _world->tile_map, TEAM_COUNT);
+    _grid.init(_world->tile_map);
+    _jobs.init();
+    connect_destroy_hooks();
+    register_systems();
 
-    auto meshFile = loadGltf(&_renderer, "assets/meshes/mannequin.glb");
-    assert(meshFile.has_value());
-    _assets = *meshFile;
+    if (!_archetypes.load("assets/units.txt")) {
+        abort();
+    }
+    if (_isReplaying &&
+        _replay.header().archetypes != _archetypes.fingerprint()) {
+        fprintf(stderr, "%s was recorded with other unit definitions\n",
+                _config.replayPath.c_str());
+        abort();
+    }
+    apply_archetypes();
+
+    if (_config.headless) {
+        // NOTE: No mesh to take the bounds from, so units get a box of
+        // roughly the mannequin's size
+        _unitBounds = math::AABB{
+            glm::vec3(-PLAYER_WIDTH / 2, 0.f, -PLAYER_WIDTH / 2),
+            glm::vec3(PLAYER_WIDTH / 2, PLAYER_HEIGHT, PLAYER_WIDTH / 2)};
+    } else {
+        _renderer.update_tile_draw_commands(
+            create_tile_map_mesh(_world->tile_map, &_jobs));
+
+        // TODO: Every unit uses the bounds of the first mesh
+        assert(!_meshes.empty());
+        _unitBounds = _meshes[0]->localBounds;
+    }
+    if (_isReplaying) {
+        _unitBounds = _replay.header().unitBounds;
+    }
+
+    if (_isScenario) {
+        init_scenario();
+    } else {
+        init_test_entities();
+    }
+
+    if (!_config.recordPath.empty()) {
+        const ScenarioConfig &scenario = _config.scenario;
+        ReplayHeader header{};
+        header.isScenario = _isScenario;
+        header.mapChunks = mapChunks;
+        header.entityCount = scenario.entityCount;
+        header.orders = (uint32_t)scenario.orders;
+        header.orderInterval = scenario.orderInterval;
+        header.seed = scenario.seed;
+        header.unitBounds = _unitBounds.value();
+        header.archetypes = _archetypes.fingerprint();
+        if (!_recorder.open(_config.recordPath.c_str(), header)) {
+            abort();
+        }
+    }
+
+    if (_config.headless) {
+        return;
+    }
 
-    init_test_entities();
+    // NOTE: From here on only the render thread touches the renderer,
+    // except for loading meshes
+    _renderThread.start(_renderer);
 }
 
 void Game::deinit() {
+    _recorder.close();
+    _jobs.deinit();
+    if (_config.headless) {
+        return;
+    }
+
+    _renderThread.stop();
     _renderer.deinit();
     SDL_DestroyWindow(_window);
     SDL_Quit();
 }
 
 void Game::run() {
-    Uint64 nextGameStep = SDL_GetTicks();
-    Uint64 last = nextGameStep;
-    Uint64 now = last;
-    SDL_Event e;
+    if (_config.headless) {
+        run_headless();
+        return;
+    }
+
+    if (_isReplaying) {
+        _tickStats.enable(_config.ticks);
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // NOTE: SDL only hands out events on the main thread, so it stays here
+    // and the simulation gets a thread of its own
     _isRunning = true;
+    std::thread simulation([this] { run_simulation(); });
+    pump_events();
+    simulation.join();
+
+    if (_isReplaying) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        printf("replayed %u of %u ticks in %.2f s, %.0f frames/s\n",
+               _tickIndex, _config.ticks, elapsed.count(),
+               (double)_tickIndex / elapsed.count());
+        _tickStats.print(stdout);
+        return;
+    }
+
+    update_loop_timings();
+    print_percentiles("main loop", _loopTimings.frameTimes, stdout);
+    print_percentiles("tick late", _loopTimings.tickLateness, stdout);
+    printf("%lu ticks dropped\n", _loopTimings.droppedTicks);
+}
+
+void Game::pump_events() {
+    SDL_Event e;
     while (_isRunning) {
-        last = now;
-        now = SDL_GetTicks();
-        if (nextGameStep >= now) {
-            SDL_Delay(nextGameStep - now);
+        if (!SDL_WaitEventTimeout(&e, 100)) {
             continue;
         }
 
-        while (nextGameStep <= now) {
-            while (SDL_PollEvent(&e)) {
-                ImGui_ImplSDL3_ProcessEvent(&e);
-                if (e.type == SDL_EVENT_QUIT) {
-                    _isRunning = false;
-                } else if (e.type == SDL_EVENT_WINDOW_RESIZED) {
-                    int width, height;
-                    SDL_GetWindowSizeInPixels(_window, &width, &height);
-                    if (width > 0 && height > 0) {
-                        _camera.set_screen_dimensions((float)width,
-                                                      (float)height);
-                    }
-                    _renderer.set_camera_projection(
-                        _camera.get_projection_matrix());
-                } else {
-                    _input.process_event(e);
-                }
+        _renderThread.forward_event(e);
+        if (e.type == SDL_EVENT_QUIT) {
+            _isRunning = false;
+        } else if (e.type == SDL_EVENT_WINDOW_RESIZED) {
+            int width, height;
+            SDL_GetWindowSizeInPixels(_window, &width, &height);
+            if (width > 0 && height > 0) {
+                _input.queue_resize(e.common.timestamp,
+                                    glm::vec2((float)width, (float)height));
             }
+        } else {
+            _input.queue_event(e);
+        }
+    }
+}
 
-            float dt = TIMESTEP_MS / 1000.f;
-            update_positions(dt);
+void Game::run_simulation() {
+    _jobs.register_thread();
 
-            nextGameStep += TIMESTEP_MS;
+    Uint64 nextTick = SDL_GetTicksNS();
+    Uint64 lastFrame = nextTick;
+    uint64_t frameCount = 0;
+    while (_isRunning) {
+        if (!_isReplaying) {
+            wait_until(nextTick);
         }
+        Uint64 now = SDL_GetTicksNS();
+        _loopFrameTimes.record(now - lastFrame);
+        lastFrame = now;
 
-        _input.update();
-        _camera.update(TIMESTEP_S);
-        if (_camera._isDirty) {
-            _renderer.set_camera_projection(_camera.get_projection_matrix());
-            _camera._isDirty = false;
+        if (_isReplaying) {
+            // NOTE: One recorded tick per frame, without waiting. The player
+            // can still move the camera, but their commands are dropped.
+            if (_tickIndex == _config.ticks) {
+                _isRunning = false;
+                break;
+            }
+            _input.consume(now, _inputCommands);
+            _inputCommands.clear();
+            take_replay_commands();
+            tick(TIMESTEP_S);
+        } else {
+            _tickLateness.record(now - nextTick);
+
+            // NOTE: Each tick takes the input that came in before its time,
+            // so which tick an event lands in does not depend on frame timing
+            uint32_t steps = 0;
+            while (nextTick <= now && steps < MAX_CATCH_UP_TICKS) {
+                _input.consume(nextTick, _inputCommands);
+                resolve_input_commands();
+                tick(TIMESTEP_S);
+                nextTick += TIMESTEP_NS;
+                steps++;
+            }
+            // NOTE: Catching up on everything after a stall would make the
+            // next frame late too, so the missed ticks are given up on and
+            // the game slows down instead
+            if (nextTick <= now) {
+                Uint64 missed = (now - nextTick) / TIMESTEP_NS + 1;
+                _droppedTicks += missed;
+                nextTick += missed * TIMESTEP_NS;
+            }
         }
+        _inputReadAt = std::chrono::steady_clock::now();
 
-        if (_input.hasPendingPickRequest()) {
-            handle_pick_request();
+        if (std::optional<glm::vec2> size = _input.take_resize()) {
+            _camera.set_screen_dimensions(size->x, size->y);
         }
+        _camera.update(TIMESTEP_S);
 
-        if (_input.hasRightClickRequest()) {
-            handle_move_request();
+        // NOTE: Nothing runs between frames, so the archetypes and the units
+        // using them can change here. Not while recording or replaying, a
+        // replay only checks the archetypes it starts with.
+        if (!_isReplaying && !_recorder.is_open() &&
+            now - _archetypesCheckedAt >= SDL_NS_PER_SECOND) {
+            _archetypesCheckedAt = now;
+            if (_archetypes.reload_if_changed()) {
+                apply_archetypes();
+            }
         }
 
-        _input.reset();
+        if (frameCount++ % 60 == 0) {
+            update_loop_timings();
+        }
 
-        auto cmd = _renderer.begin_frame();
-        render_entities();
-        _renderer.draw(cmd);
-        _renderer.end_frame(cmd, now - last);
+        // NOTE: Ends by publishing a snapshot for the render thread
+        _frameSystems.run(_jobs);
     }
 }
 
-void Game::handle_pick_request() {
-    Ray clickRay = screen_point_to_ray(_input.lastLeftClickPos());
+void Game::update_loop_timings() {
+    _loopTimings.frameTimes = _loopFrameTimes.percentiles();
+    _loopTimings.tickLateness = _tickLateness.percentiles();
+    _loopTimings.droppedTicks = _droppedTicks;
+}
+
+/// Keeps the structures outside the registry in sync when entities go away,
+/// however they are destroyed
+void Game::connect_destroy_hooks() {
+    _registry.on_destroy<TransformNode>()
+        .connect<&Game::on_destroy_transform_node>(*this);
+    _registry.on_destroy<BVHProxy>().connect<&Game::on_destroy_bvh_proxy>(
+        *this);
+    _registry.on_destroy<AvoidanceAgent>()
+        .connect<&Game::on_destroy_avoidance_agent>(*this);
+    _registry.on_destroy<FogViewer>().connect<&Game::on_destroy_fog_viewer>(
+        *this);
+}
+
+void Game::on_destroy_transform_node(entt::registry &registry,
+                                     entt::entity entity) {
+    _transforms.destroy(registry.get<TransformNode>(entity).handle);
+}
+
+void Game::on_destroy_bvh_proxy(entt::registry &registry,
+                                entt::entity entity) {
+    _bvh.remove(registry.get<BVHProxy>(entity).node);
+}
+
+void Game::on_destroy_avoidance_agent(entt::registry &registry,
+                                      entt::entity entity) {
+    if (_grid.contains(entity)) {
+        _grid.remove(entity);
+    }
+    if (_broadphase.contains(entity)) {
+        _broadphase.remove(entity);
+    }
+}
+
+void Game::on_destroy_fog_viewer(entt::registry &registry,
+                                 entt::entity entity) {
+    const FogViewer &viewer = registry.get<FogViewer>(entity);
+    if (viewer.isStamped) {
+        fog_remove_viewer(_fog, viewer.team, viewer.tileX, viewer.tileY,
+                          viewer.radius);
+    }
+}
+
+void Game::register_systems() {
+    // NOTE: Created up front so no system adds a group while others run
+    _registry.group<Transform, MovementSpeed, AvoidanceAgent>();
 
-    entt::entity selectedEntity = entt::null;
+    // NOTE: Registered first so commands act on the state the player saw
+    _tickSystems
+        .add_system("handle_input_commands",
+                    [this] { handle_input_commands(); })
+        .reads<TransformNode, Selected>()
+        .reads_resource(&_tickCommands)
+        .reads_resource(&_transforms)
+        .reads_resource(&_bvh);
+    _tickSystems
+        .add_system("update_positions", [this] { update_positions(_tickDt); })
+        .reads<MovementSpeed, TargetPositionComponent>()
+        .writes<Transform, AvoidanceAgent>()
+        .reads_resource(_world)
+        .reads_resource(&_grid)
+        .writes_resource(&_agents)
+        .writes_resource(&_movers)
+        .writes_resource(&_headings)
+        .writes_resource(&_movedEntities);
+    _tickSystems
+        .add_system("resolve_collisions", [this] { resolve_collisions(); })
+        .reads<AvoidanceAgent>()
+        .writes<Transform>()
+        .reads_resource(_world)
+        .writes_resource(&_broadphase)
+        .writes_resource(&_collisionPairs)
+        .writes_resource(&_movedEntities);
+    _tickSystems
+        .add_system("update_moved_entities",
+                    [this] { update_moved_entities(); })
+        .reads<Transform, TransformNode, BVHProxy>()
+        .reads_resource(&_movedEntities)
+        .writes_resource(&_transforms)
+        .writes_resource(&_changedTransforms)
+        .writes_resource(&_movedMatrices)
+        .writes_resource(&_movedBounds)
+        .writes_resource(&_grid)
+        .writes_resource(&_bvh);
+    _tickSystems
+        .add_system("update_fog_of_war", [this] { update_fog_of_war(); })
+        .reads<Transform, Team>()
+        .writes<FogViewer>()
+        .writes_resource(_fog);
+    _tickSystems.add_sync_point("apply_commands",
+                                [this] { _commands.play(_registry); });
 
-    auto view = _registry.view<UnitType, Transform>();
-    view.each([this, clickRay, &selectedEntity](const auto entity, auto &type,
-                                                auto &transform) {
-        UnitData unitData = UnitData::registry.at(type);
-        // TODO: This sucks
-        const Scene &scene = *_assets.get();
-        glm::mat4 worldTransform = transform.as_matrix();
-        glm::mat4 invWorldTransform = glm::inverse(worldTransform);
+    if (_config.headless) {
+        return;
+    }
+
+    _frameSystems
+        .add_system("snapshot_units", [this] { snapshot_units(); })
+        .reads<ArchetypeId, Transform>()
+        .writes_resource(&_snapshot);
+
+    _frameSystems.add_sync_point("publish_snapshot", [this] {
+        _commands.play(_registry);
+        _input.reset();
 
-        glm::vec3 localRayOrigin =
-            glm::vec3(invWorldTransform * glm::vec4(clickRay.origin, 1.0f));
-        glm::vec3 localRayDir =
-            glm::vec3(invWorldTransform * glm::vec4(clickRay.direction, 0.0f));
-        localRayDir = glm::normalize(localRayDir);
-        Ray localRay = Ray{localRayOrigin, localRayDir};
+        if (_input.isBoxSelecting()) {
+            _snapshot->selectionRect = std::array<glm::vec2, 2>{
+                _input.leftDragStartPos(), _input.mousePos()};
+        }
+        _snapshot->view = _camera.get_view_matrix();
+        _snapshot->projection = _camera.get_projection_matrix();
 
-        std::optional<math::AABB> sceneAABB = scene.get_local_aabb();
-        if (sceneAABB.has_value() &&
-            math::intersect_ray_aabb(localRay, sceneAABB.value())) {
-            selectedEntity = entity;
+        FogTeam &playerFog = _fog->teams[PLAYER_TEAM];
+        if (playerFog.texture_dirty) {
+            const uint32_t *texels = (const uint32_t *)playerFog.texels;
+            size_t texelCount = (size_t)_fog->texels_per_row * _fog->height * 2;
+            _fogSnapshot = std::make_shared<const FogSnapshot>(FogSnapshot{
+                std::vector<uint32_t>(texels, texels + texelCount),
+                VkExtent2D{_fog->texels_per_row, _fog->height}});
+            playerFog.texture_dirty = false;
         }
+        _snapshot->inputTime = _inputReadAt;
+        _snapshot->loopTimings = _loopTimings;
+        _snapshot->fog = _fogSnapshot;
+        _snapshot->meshes = _meshes;
+
+        _renderThread.publish(std::move(_snapshot));
     });
+}
 
-    if (selectedEntity == entt::null) {
-        return;
+void Game::tick(float dt) {
+    const ScenarioConfig &scenario = _config.scenario;
+    if (_isScenario &&
+        (_tickIndex == 0 || (scenario.orderInterval > 0 &&
+                             _tickIndex % scenario.orderInterval == 0))) {
+        give_scenario_orders();
+    }
+    if (_recorder.is_open()) {
+        _recorder.record_tick(_tickCommands);
+    }
+
+    _tickDt = dt;
+    _tickStats.time("tick", [this] { _tickSystems.run(_jobs); });
+    _tickSystems.record_timings(_tickStats);
+    _tickCommands.clear();
+    _tickIndex++;
+}
+
+/// Jobs run, total and worst time per job name
+static void print_job_profile(const std::vector<JobSample> &samples,
+                              FILE *out) {
+    struct JobTotals {
+        const char *name;
+        uint32_t count;
+        double totalUs;
+        double maxUs;
+    };
+    std::vector<JobTotals> totals;
+    for (const JobSample &sample : samples) {
+        double us =
+            std::chrono::duration<double, std::micro>(sample.end - sample.start)
+                .count();
+        auto it = std::find_if(
+            totals.begin(), totals.end(),
+            [&sample](const JobTotals &t) { return t.name == sample.name; });
+        if (it == totals.end()) {
+            totals.push_back(JobTotals{sample.name, 1, us, us});
+        } else {
+            it->count++;
+            it->totalUs += us;
+            it->maxUs = std::max(it->maxUs, us);
+        }
     }
 
-    _registry.view<Selected>()->clear();
-    _registry.emplace<Selected>(selectedEntity);
+    fprintf(out, "%-24s %10s %10s %10s\n", "job", "count", "total ms",
+            "max us");
+    for (const JobTotals &t : totals) {
+        fprintf(out, "%-24s %10u %10.1f %10.1f\n", t.name, t.count,
+                t.totalUs / 1000.0, t.maxUs);
+    }
+}
+
+void Game::run_headless() {
+    _tickStats.enable(_config.ticks);
+    _jobs.set_profiling(true);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < _config.ticks; i++) {
+        if (_isReplaying) {
+            take_replay_commands();
+        }
+        tick(TIMESTEP_S);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    uint32_t mapChunks = _world->tile_map->n_tile_chunk_x;
+    printf("%u ticks of %zu entities on %ux%u chunks in %.2f s, %.0f ticks/s\n",
+           _config.ticks, _registry.view<ArchetypeId>().size(), mapChunks,
+           mapChunks, elapsed.count(),
+           (double)_config.ticks / elapsed.count());
+    _tickStats.print(stdout);
+
+    std::vector<JobSample> samples;
+    _jobs.collect_samples(samples);
+    printf("\n%u threads\n", _jobs.thread_count());
+    print_job_profile(samples, stdout);
 }
 
-void Game::handle_move_request() {
-    Ray ray = screen_point_to_ray(_input.lastRightClickPos());
+/// Resolves the commands of the player against the camera as it is now, so
+/// the tick that runs them does not read the camera
+void Game::resolve_input_commands() {
+    for (const InputCommand &command : _inputCommands) {
+        GameCommand resolved{};
+        switch (command.type) {
+        case InputCommandType::kPick:
+            resolved.type = GameCommandType::kPick;
+            resolved.ray = screen_point_to_ray(glm::vec2(command.start));
+            break;
+        case InputCommandType::kBoxSelect:
+            resolved.type = GameCommandType::kBoxSelect;
+            resolved.frustum =
+                screen_rect_to_frustum(command.start, command.end);
+            break;
+        case InputCommandType::kMove: {
+            resolved.type = GameCommandType::kMove;
+            Ray ray = screen_point_to_ray(glm::vec2(command.start));
+
+            // TODO: Only works when ground is 0.f high
+            glm::vec3 groundPlaneOrigin = glm::vec3(0.0f, 0.f, 0.0f);
+            glm::vec3 groundPlaneNormal = glm::vec3(0.0f, 1.0f, 0.0f);
+            resolved.point = math::intersect_ray_plane(ray, groundPlaneOrigin,
+                                                       groundPlaneNormal);
+            break;
+        }
+        }
+        _tickCommands.push_back(resolved);
+    }
+    _inputCommands.clear();
+}
+
+void Game::take_replay_commands() {
+    std::span<const GameCommand> commands =
+        _replay.tick_commands(_tickIndex);
+    _tickCommands.assign(commands.begin(), commands.end());
+}
 
-    // TODO: Only works when ground is 0.f high
-    glm::vec3 groundPlaneOrigin = glm::vec3(0.0f, 0.f, 0.0f);
-    glm::vec3 groundPlaneNormal = glm::vec3(0.0f, 1.0f, 0.0f);
+void Game::handle_input_commands() {
+    if (_tickCommands.empty()) {
+        return;
+    }
 
+    // NOTE: A new selection only reaches the registry when the commands are
+    // played at the end of the tick, so later commands of the same tick read
+    // it from here
     auto selectedView = _registry.view<Selected>();
-    selectedView.each(
-        [this, ray, groundPlaneOrigin, groundPlaneNormal](const auto entity) {
-            glm::vec3 intersectionPoint = math::intersect_ray_plane(
-                ray, groundPlaneOrigin, groundPlaneNormal);
-            _registry.emplace_or_replace<TargetPositionComponent>(
-                entity, intersectionPoint);
+    std::vector<entt::entity> selection(selectedView.begin(),
+                                        selectedView.end());
+    bool isSelectionChanged = false;
+    for (const GameCommand &command : _tickCommands) {
+        switch (command.type) {
+        case GameCommandType::kPick:
+            isSelectionChanged |= pick(command.ray, selection);
+            break;
+        case GameCommandType::kBoxSelect:
+            isSelectionChanged |= box_select(command.frustum, selection);
+            break;
+        case GameCommandType::kMove:
+            order_move(command.point, selection);
+            break;
+        }
+    }
+
+    if (isSelectionChanged) {
+        _commands.remove<Selected>(selectedView.begin(), selectedView.end());
+        for (entt::entity entity : selection) {
+            _commands.emplace<Selected>(entity);
+        }
+    }
+}
+
+bool Game::pick(const Ray &clickRay, std::vector<entt::entity> &selection) {
+    if (!_unitBounds.has_value()) {
+        return false;
+    }
+    const math::AABB &localBounds = _unitBounds.value();
+
+    auto hitEntity = [this, &clickRay, &localBounds](uint32_t userData,
+                                                     float maxDistance) {
+        entt::entity entity = (entt::entity)userData;
+        TransformNode node = _registry.get<TransformNode>(entity);
+        glm::mat4 invWorldTransform =
+            glm::inverse(_transforms.world_matrix(node.handle));
+
+        // NOTE: The direction is left unnormalized, so the distance along the
+        // local ray is the same as along the world ray and hits of different
+        // entities can be compared
+        math::RayPacket localRay(Ray{
+            glm::vec3(invWorldTransform * glm::vec4(clickRay.origin, 1.0f)),
+            glm::vec3(invWorldTransform * glm::vec4(clickRay.direction, 0.0f)),
         });
+
+        float distance;
+        if (!math::intersect_ray_aabb(localRay, localBounds, maxDistance,
+                                      distance)) {
+            return -1.f;
+        }
+        return distance;
+    };
+
+    float distance;
+    uint32_t userData;
+    if (!_bvh.raycast(clickRay, hitEntity, distance, userData)) {
+        return false;
+    }
+
+    selection.assign(1, (entt::entity)userData);
+    return true;
+}
+
+bool Game::box_select(const math::Frustum &frustum,
+                      std::vector<entt::entity> &selection) {
+    if (!_unitBounds.has_value()) {
+        return false;
+    }
+
+    // NOTE: The tree holds fattened bounds, so candidates get a second test
+    // against their exact world bounds
+    selection.clear();
+    _bvh.query(frustum, [this, &frustum, &selection](uint32_t userData) {
+        entt::entity entity = (entt::entity)userData;
+        TransformNode node = _registry.get<TransformNode>(entity);
+        math::AABB bounds =
+            _unitBounds->transform(_transforms.world_matrix(node.handle));
+        if (math::intersect_frustum_aabb(frustum, bounds)) {
+            selection.push_back(entity);
+        }
+    });
+
+    return true;
+}
+
+void Game::order_move(glm::vec3 point,
+                      std::span<const entt::entity> selection) {
+    for (entt::entity entity : selection) {
+        _commands.emplace<TargetPositionComponent>(
+            entity, TargetPositionComponent{point});
+    }
+}
+
+// NOTE: Units are roots of the transform hierarchy, so their Transform is
+// their world transform
+void Game::snapshot_units() {
+    _snapshot = _renderThread.acquire();
+    auto view = _registry.view<ArchetypeId, Transform>();
+    view.each([this](const auto entity, const auto &id, const auto &transform) {
+        uint32_t mesh = _archetypes.stats(id).mesh;
+        if (mesh != UnitArchetypes::kNoMesh) {
+            _snapshot->add(entity, transform, mesh);
+        }
+    });
+}
+
+Prefab Prefab::from_archetype(ArchetypeId id, const ArchetypeStats &stats) {
+    Prefab prefab;
+    prefab.archetype = id;
+    prefab.movementSpeed = MovementSpeed{stats.movementSpeed};
+    prefab.agent = AvoidanceAgent{glm::vec2(0.f), stats.radius};
+    prefab.fogViewer = FogViewer{stats.sightRadius};
+    return prefab;
 }
 
-void Game::render_entities() {
-    auto view = _registry.view<UnitType, Transform>();
-    view.each([this](const auto entity, auto &type, auto &transform) {
-        UnitData unitData = UnitData::registry.at(type);
-        glm::mat4 worldTransform = transform.as_matrix();
-        const Scene &scene = *_assets.get();
-        _renderer.draw_scene(scene, worldTransform);
+void Game::apply_archetypes() {
+    if (!_config.headless) {
+        load_archetype_meshes();
+    }
+
+    _prefabs.resize(_archetypes.size());
+    for (uint32_t i = 0; i < _archetypes.size(); i++) {
+        ArchetypeId id{(uint16_t)i};
+        _prefabs[i] = Prefab::from_archetype(id, _archetypes.stats(id));
+    }
+
+    // NOTE: Units copy the stats they use when spawned
+    auto view = _registry.view<ArchetypeId, Transform, MovementSpeed,
+                               AvoidanceAgent, FogViewer>();
+    view.each([this](const auto entity, const auto &id, const auto &transform,
+                     auto &movementSpeed, auto &agent, auto &viewer) {
+        const ArchetypeStats &stats = _archetypes.stats(id);
+        movementSpeed.value = stats.movementSpeed;
+
+        if (agent.radius != stats.radius) {
+            agent.radius = stats.radius;
+            glm::vec3 position = transform.position();
+            glm::vec2 groundPosition{position.x, position.z};
+            _grid.remove(entity);
+            _grid.insert(entity, position, agent.radius);
+            _broadphase.update(entity, groundPosition - agent.radius,
+                               groundPosition + agent.radius);
+        }
+
+        // NOTE: The stamp has to come off with the radius it was made with,
+        // the next tick stamps the new one
+        if (viewer.radius != stats.sightRadius) {
+            if (viewer.isStamped) {
+                fog_remove_viewer(_fog, viewer.team, viewer.tileX,
+                                  viewer.tileY, viewer.radius);
+                viewer.isStamped = false;
+            }
+            viewer.radius = stats.sightRadius;
+        }
     });
 }
 
-void Game::add_entity(UnitType &&type, WorldPosition &&pos) {
-    auto data = UnitData::registry.at(type);
-    const auto entity = _registry.create();
-    _registry.emplace<Transform>(entity, pos.to_world_transform());
-    _registry.emplace<UnitType>(entity, type);
-    _registry.emplace<MovementSpeed>(entity, data.movementSpeed);
+void Game::load_archetype_meshes() {
+    for (uint32_t i = 0; i < _archetypes.size(); i++) {
+        ArchetypeId id{(uint16_t)i};
+        const std::string &path = _archetypes.mesh_path(id);
+        if (path.empty() ||
+            _archetypes.stats(id).mesh != UnitArchetypes::kNoMesh) {
+            continue;
+        }
+
+        auto loaded = std::find(_meshPaths.begin(), _meshPaths.end(), path);
+        if (loaded == _meshPaths.end()) {
+            auto meshFile = loadGltf(&_renderer, path);
+            if (!meshFile.has_value()) {
+                fprintf(stderr, "could not load mesh %s\n", path.c_str());
+                continue;
+            }
+            _meshes.push_back(*meshFile);
+            _meshPaths.push_back(path);
+            loaded = _meshPaths.end() - 1;
+        }
+        _archetypes.set_mesh(id, (uint32_t)(loaded - _meshPaths.begin()));
+    }
+}
+
+const Prefab &Game::find_prefab(std::string_view name) const {
+    uint16_t index = _archetypes.find(name);
+    if (index == UnitArchetypes::kInvalidArchetype) {
+        fprintf(stderr, "no unit archetype named %.*s\n", (int)name.size(),
+                name.data());
+        abort();
+    }
+    return _prefabs[index];
+}
+
+void Game::spawn_batch(const Prefab &prefab,
+                       std::span<const WorldPosition> positions,
+                       uint8_t team) {
+    std::vector<entt::entity> entities(positions.size());
+    std::vector<Transform> transforms(positions.size());
+    std::vector<TransformNode> nodes(positions.size());
+
+    _registry.create(entities.begin(), entities.end());
+    for (size_t i = 0; i < positions.size(); i++) {
+        transforms[i] = positions[i].to_world_transform(_world->tile_map);
+        nodes[i].handle =
+            _transforms.create(transforms[i], entt::to_integral(entities[i]));
+    }
+
+    _registry.insert<Transform>(entities.begin(), entities.end(),
+                                transforms.begin());
+    _registry.insert<TransformNode>(entities.begin(), entities.end(),
+                                    nodes.begin());
+    _registry.insert<ArchetypeId>(entities.begin(), entities.end(),
+                                  prefab.archetype);
+    _registry.insert<MovementSpeed>(entities.begin(), entities.end(),
+                                    prefab.movementSpeed);
+    _registry.insert<Team>(entities.begin(), entities.end(), Team{team});
+    _registry.insert<FogViewer>(entities.begin(), entities.end(),
+                                prefab.fogViewer);
+    _registry.insert<AvoidanceAgent>(entities.begin(), entities.end(),
+                                     prefab.agent);
+
+    float radius = prefab.agent.radius;
+    for (size_t i = 0; i < entities.size(); i++) {
+        glm::vec3 position = transforms[i].position();
+        _grid.insert(entities[i], position, radius);
+        _broadphase.insert(entities[i],
+                           glm::vec2(position.x, position.z) - radius,
+                           glm::vec2(position.x, position.z) + radius);
+    }
+
+    if (!_unitBounds.has_value()) {
+        return;
+    }
+
+    std::vector<glm::mat4> matrices(entities.size());
+    std::vector<math::AABB> bounds(entities.size());
+    std::vector<BVHProxy> proxies(entities.size());
+    for (size_t i = 0; i < entities.size(); i++) {
+        matrices[i] = _transforms.world_matrix(nodes[i].handle);
+    }
+    math::transform_aabb_instances(*_unitBounds, matrices, bounds);
+    for (size_t i = 0; i < entities.size(); i++) {
+        proxies[i].node =
+            _bvh.insert(bounds[i], entt::to_integral(entities[i]));
+    }
+    _registry.insert<BVHProxy>(entities.begin(), entities.end(),
+                               proxies.begin());
 }
 
 void Game::update_positions(float dt) {
-    auto view =
-        _registry.view<Transform, TargetPositionComponent, MovementSpeed>();
-    view.each([this, dt](const auto &entity, auto &currentTransform,
-                         const auto &targetPosition,
-                         const auto &movementSpeed) {
-        glm::vec3 currentPosition = currentTransform.position();
-        glm::vec3 vecToTarget = targetPosition.value - currentPosition;
-        float targetDistance = glm::length(vecToTarget);
-
-        if (targetDistance <= 0.1f) {
-            _registry.remove<TargetPositionComponent>(entity);
+    _agents.clear();
+
+    // NOTE: The group keeps these packed in the same order, so walking it
+    // twice visits the agents in the order they were added
+    auto units = _registry.group<Transform, MovementSpeed, AvoidanceAgent>();
+    units.each([this](const auto entity, const auto &transform,
+                      const auto &movementSpeed, const auto &agent) {
+        glm::vec3 position = transform.position();
+        _agents.add(entity, glm::vec2(position.x, position.z), agent.velocity,
+                    glm::vec2(0.f), agent.radius, movementSpeed.value);
+    });
+
+    _movers.clear();
+    auto targets = _registry.view<TargetPositionComponent>();
+    targets.each([this](const auto entity, const auto &target) {
+        uint32_t agent = _agents.find(entity);
+        if (agent == kInvalidAgent) {
+            return;
+        }
+        _movers.add(entity, agent, _agents.positions[agent],
+                    glm::vec2(target.value.x, target.value.z),
+                    _agents.maxSpeeds[agent]);
+    });
+
+    steer_movers(_movers, 0.1f, dt);
+    for (size_t i = 0; i < _movers.size(); i++) {
+        if (_movers.hasArrived[i]) {
+            _commands.remove<TargetPositionComponent>(_movers.entities[i]);
+        }
+        _agents.preferredVelocities[_movers.agentIndices[i]] =
+            glm::vec2(_movers.velocityX[i], _movers.velocityZ[i]);
+    }
+
+    compute_avoidance_velocities(_agents, _grid, AvoidanceParams{}, dt, _jobs);
+    compute_headings(_agents.newVelocities, _headings);
+
+    _movedEntities.clear();
+    uint32_t i = 0;
+    units.each([this, dt, &i](const auto entity, auto &transform, const auto &,
+                              auto &agent) {
+        uint32_t index = i++;
+        glm::vec2 velocity = _agents.newVelocities[index];
+        agent.velocity = velocity;
+
+        // NOTE: Units standing still don't touch the spatial structures
+        if (glm::dot(velocity, velocity) <= 1e-6f) {
             return;
         }
 
-        glm::vec3 moveDirection = glm::normalize(vecToTarget);
-        float moveDistance = std::min(movementSpeed.value * dt, targetDistance);
-        currentTransform.position(currentPosition +
-                                  moveDirection * moveDistance);
+        glm::vec2 position = move_circle_against_tiles(
+            _world->tile_map, _agents.positions[index], velocity * dt,
+            _agents.radii[index]);
+        transform.position(
+            glm::vec3(position.x, transform.position().y, position.y));
+        transform.heading(_headings.get(index));
+        _movedEntities.push_back(entity);
+    });
+}
+
+void Game::resolve_collisions() {
+    for (entt::entity entity : _movedEntities) {
+        glm::vec3 position = _registry.get<Transform>(entity).position();
+        float radius = _registry.get<AvoidanceAgent>(entity).radius;
+        _broadphase.update(entity, glm::vec2(position.x, position.z) - radius,
+                           glm::vec2(position.x, position.z) + radius);
+    }
+
+    _collisionPairs.clear();
+    _broadphase.find_pairs(_collisionPairs);
+
+    for (const CollisionPair &pair : _collisionPairs) {
+        Transform &transformA = _registry.get<Transform>(pair.a);
+        Transform &transformB = _registry.get<Transform>(pair.b);
+        float radiusA = _registry.get<AvoidanceAgent>(pair.a).radius;
+        float radiusB = _registry.get<AvoidanceAgent>(pair.b).radius;
+
+        glm::vec3 positionA = transformA.position();
+        glm::vec3 positionB = transformB.position();
+        glm::vec2 a{positionA.x, positionA.z};
+        glm::vec2 b{positionB.x, positionB.z};
+        if (!resolve_circle_circle(a, radiusA, b, radiusB)) {
+            continue;
+        }
+
+        // NOTE: Being pushed by another unit must not end up inside a wall
+        a = depenetrate_circle_from_tiles(_world->tile_map, a, radiusA);
+        b = depenetrate_circle_from_tiles(_world->tile_map, b, radiusB);
+        transformA.position(glm::vec3(a.x, positionA.y, a.y));
+        transformB.position(glm::vec3(b.x, positionB.y, b.y));
+        _broadphase.update(pair.a, a - radiusA, a + radiusA);
+        _broadphase.update(pair.b, b - radiusB, b + radiusB);
+        _movedEntities.push_back(pair.a);
+        _movedEntities.push_back(pair.b);
+    }
+}
+
+void Game::update_moved_entities() {
+    // NOTE: Entities moved twice in a step are only marked dirty once
+    for (entt::entity entity : _movedEntities) {
+        _transforms.set_local(_registry.get<TransformNode>(entity).handle,
+                              _registry.get<Transform>(entity));
+    }
+
+    _changedTransforms.clear();
+    _transforms.update(_changedTransforms);
+
+    _movedMatrices.clear();
+    for (TransformHierarchy::Handle handle : _changedTransforms) {
+        entt::entity entity = (entt::entity)_transforms.user_data(handle);
+        const glm::mat4 &world = _transforms.world_matrix(handle);
+        if (_grid.contains(entity)) {
+            _grid.move(entity, glm::vec3(world[3]));
+        }
+        _movedMatrices.push_back(world);
+    }
+
+    if (!_unitBounds.has_value()) {
+        return;
+    }
+
+    _movedBounds.resize(_movedMatrices.size());
+    math::transform_aabb_instances(_unitBounds.value(), _movedMatrices,
+                                   _movedBounds);
+    for (size_t i = 0; i < _changedTransforms.size(); i++) {
+        entt::entity entity =
+            (entt::entity)_transforms.user_data(_changedTransforms[i]);
+        if (const BVHProxy *proxy = _registry.try_get<BVHProxy>(entity)) {
+            _bvh.move(proxy->node, _movedBounds[i]);
+        }
+    }
+}
+
+void Game::update_fog_of_war() {
+    auto view = _registry.view<Transform, Team, FogViewer>();
+    TileMap *tm = _world->tile_map;
+    view.each([this, tm](const auto &transform, const auto &team,
+                         auto &viewer) {
+        glm::vec3 pos = transform.position();
+        int32_t tileX = world_to_tile(tm, pos.x);
+        int32_t tileY = world_to_tile(tm, pos.z);
+
+        // NOTE: Only units that crossed a tile boundary touch the fog
+        if (viewer.isStamped && viewer.tileX == tileX &&
+            viewer.tileY == tileY) {
+            return;
+        }
 
-        glm::quat currentHeading = currentTransform.heading();
-        glm::quat targetHeading =
-            glm::quatLookAt(moveDirection, math::GLOBAL_UP_AXIS);
-        // TODO: Define somewhere
-        static const float rotationSpeed = 1.f;
-        glm::quat newHeading =
-            glm::slerp(currentHeading, targetHeading, rotationSpeed);
-        currentTransform.heading(newHeading);
+        if (viewer.isStamped) {
+            fog_remove_viewer(_fog, viewer.team, viewer.tileX, viewer.tileY,
+                              viewer.radius);
+        }
+        fog_add_viewer(_fog, team.value, tileX, tileY, viewer.radius);
+        viewer.team = team.value;
+        viewer.tileX = tileX;
+        viewer.tileY = tileY;
+        viewer.isStamped = true;
     });
+
+    fog_resolve(_fog);
 }
 
 void Game::init_test_entities() {
-    add_entity(UnitType::kCube, {5, 5, 0.f, 0.f});
-    add_entity(UnitType::kCube, {10, 10, 0.f, 0.f});
+    WorldPosition positions[] = {{5, 5, 0.f, 0.f}, {10, 10, 0.f, 0.f}};
+    spawn_batch(find_prefab("Cube"), positions);
+}
+
+void Game::init_scenario() {
+    _scenarioRng.seed(_config.scenario.seed);
+    TileMap *tm = _world->tile_map;
+    std::vector<WorldPosition> positions[TEAM_COUNT];
+    for (uint32_t i = 0; i < _config.scenario.entityCount; i++) {
+        positions[i % TEAM_COUNT].push_back(
+            WorldPosition::from_world_point(tm, random_traversible_point()));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const Prefab &prefab = find_prefab("Cube");
+    for (uint8_t team = 0; team < TEAM_COUNT; team++) {
+        spawn_batch(prefab, positions[team], team);
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("spawned %u entities in %.2f ms\n", _config.scenario.entityCount,
+           elapsed.count());
+}
+
+void Game::give_scenario_orders() {
+    OrderPattern orders = _config.scenario.orders;
+    if (orders == OrderPattern::kIdle) {
+        return;
+    }
+
+    TileMap *tm = _world->tile_map;
+    glm::vec3 mapSize(
+        tile_to_world(tm, (int32_t)(tm->n_tile_chunk_x * tm->chunk_dim)), 0.f,
+        tile_to_world(tm, (int32_t)(tm->n_tile_chunk_y * tm->chunk_dim)));
+    glm::vec3 margin(0.5f * tm->tile_side, 0.f, 0.5f * tm->tile_side);
+    glm::vec3 center = traversible_map_center();
+    auto view = _registry.view<ArchetypeId, Transform>();
+    for (entt::entity entity : view) {
+        glm::vec3 target;
+        switch (orders) {
+        case OrderPattern::kIdle:
+            return;
+        case OrderPattern::kRandom:
+            target = random_traversible_point();
+            break;
+        case OrderPattern::kConverge:
+            target = center;
+            break;
+        case OrderPattern::kSwap:
+            target = 2.f * center - view.get<Transform>(entity).position();
+            target = glm::clamp(target, margin, mapSize - margin);
+            break;
+        }
+        _registry.emplace_or_replace<TargetPositionComponent>(entity, target);
+    }
+}
+
+glm::vec3 Game::random_traversible_point() {
+    TileMap *tm = _world->tile_map;
+    std::uniform_int_distribution<uint32_t> tileX(
+        0, tm->n_tile_chunk_x * tm->chunk_dim - 1);
+    std::uniform_int_distribution<uint32_t> tileY(
+        0, tm->n_tile_chunk_y * tm->chunk_dim - 1);
+    std::uniform_real_distribution<float> offset(0.1f, 0.9f);
+
+    while (true) {
+        WorldPosition pos{tileX(_scenarioRng), tileY(_scenarioRng), 0.f, 0.f};
+        if (is_world_point_traversible(tm, pos)) {
+            pos.tile_rel_x = offset(_scenarioRng) * tm->tile_side;
+            pos.tile_rel_y = offset(_scenarioRng) * tm->tile_side;
+            return pos.to_world_transform(tm).position();
+        }
+    }
+}
+
+glm::vec3 Game::traversible_map_center() {
+    TileMap *tm = _world->tile_map;
+    WorldPosition pos{tm->n_tile_chunk_x * tm->chunk_dim / 2,
+                      tm->n_tile_chunk_y * tm->chunk_dim / 2, 0.f, 0.f};
+    // NOTE: Chunk borders are walls, so the exact middle may be one
+    while (!is_world_point_traversible(tm, pos)) {
+        pos.abs_tile_x++;
+        pos.abs_tile_y++;
+    }
+    pos.tile_rel_x = 0.5f * tm->tile_side;
+    pos.tile_rel_y = 0.5f * tm->tile_side;
+    return pos.to_world_transform(tm).position();
 }
 
 Ray Game::screen_point_to_ray(glm::vec2 &&point) {
-    VkExtent2D extent = _renderer.swapchainExtent();
-    assert(extent.width > 0 && extent.height > 0);
+    glm::vec2 screenSize = _camera.screen_dimensions();
+    assert(screenSize.x > 0.f && screenSize.y > 0.f);
 
-    float ndcX = (2.0f * point.x) / (float)extent.width - 1.0f;
-    float ndcY = (2.0f * point.y) / (float)extent.height - 1.0f;
+    float ndcX = (2.0f * point.x) / screenSize.x - 1.0f;
+    float ndcY = (2.0f * point.y) / screenSize.y - 1.0f;
     glm::vec2 ndcCoords = {ndcX, ndcY};
 
     // TODO: Maybe cache the matrices in the camera class?
@@ -241,3 +1074,39 @@ Ray Game::screen_point_to_ray(glm::vec2 &&point) {
 
     return Ray{.origin = rayOrigin, .direction = rayDirection};
 }
+
+math::Frustum Game::screen_rect_to_frustum(const glm::vec2 &start,
+                                           const glm::vec2 &end) {
+    glm::vec2 screenSize = _camera.screen_dimensions();
+    assert(screenSize.x > 0.f && screenSize.y > 0.f);
+
+    glm::vec2 screenMin = glm::min(start, end);
+    glm::vec2 screenMax = glm::max(start, end);
+    // NOTE: A flat rectangle gives side planes without a normal
+    assert(screenMax.x > screenMin.x && screenMax.y > screenMin.y);
+    glm::vec2 ndcMin = 2.f * screenMin / screenSize - 1.f;
+    glm::vec2 ndcMax = 2.f * screenMax / screenSize - 1.f;
+
+    glm::mat4 invProj = glm::inverse(_camera.get_projection_matrix());
+    glm::mat4 invView = glm::inverse(_camera.get_view_matrix());
+    auto unproject = [&invProj, &invView](float x, float y, float z) {
+        glm::vec4 world = invView * invProj * glm::vec4(x, y, z, 1.f);
+        return glm::vec3(world) / world.w;
+    };
+
+    // NOTE: Depth goes from 0 at the near plane to 1 at the far plane
+    std::array<glm::vec3, 4> nearCorners = {
+        unproject(ndcMin.x, ndcMin.y, 0.f),
+        unproject(ndcMax.x, ndcMin.y, 0.f),
+        unproject(ndcMax.x, ndcMax.y, 0.f),
+        unproject(ndcMin.x, ndcMax.y, 0.f),
+    };
+    std::array<glm::vec3, 4> farCorners = {
+        unproject(ndcMin.x, ndcMin.y, 1.f),
+        unproject(ndcMax.x, ndcMin.y, 1.f),
+        unproject(ndcMax.x, ndcMax.y, 1.f),
+        unproject(ndcMin.x, ndcMax.y, 1.f),
+    };
+
+    return math::frustum_from_corners(nearCorners, farCorners);
+}
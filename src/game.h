@@ -1,13 +1,34 @@
 #pragma once
+#include "avoidance.h"
 #include "camera.h"
+#include "collision.h"
+#include "command_buffer.h"
+#include "fog.h"
 #include "input.h"
+#include "math/aabb_batch.h"
+#include "math/bvh.h"
+#include "math/frustum.h"
 #include "math/intersection.h"
+#include "math/transform_hierarchy.h"
 #include "memory.h"
+#include "movement.h"
+#include "parallel.h"
+#include "render_thread.h"
 #include "renderer/renderer.hpp"
+#include "replay.h"
+#include "scheduler.h"
+#include "spatial_grid.h"
+#include "tick_stats.h"
 #include "tile.h"
+#include "unit_archetypes.h"
 #include <SDL3/SDL.h>
+#include <atomic>
 #include <entt/entt.hpp>
-#include <unordered_map>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
 
 // TODO: This value is completely arbitrary
 #define GAME_MEMORY 1024 * 1024 * 64
@@ -18,39 +39,177 @@
 #define PLAYER_WIDTH (0.70 * PLAYER_HEIGHT)
 #define PLAYER_SPEED 5.0f
 
-enum UnitType {
-    kCube,
+#define TEAM_COUNT 2
+#define PLAYER_TEAM 0
+
+enum class OrderPattern {
+    kIdle,
+    /// Every unit walks to its own random tile
+    kRandom,
+    /// Every unit walks to the middle of the map
+    kConverge,
+    /// Every unit walks to its mirror image through the middle of the map, so
+    /// the crowds cross each other
+    kSwap,
+};
+
+/// What a headless run simulates
+struct ScenarioConfig {
+    uint32_t entityCount{1000};
+    /// The map is mapChunks x mapChunks chunks of 32x32 tiles
+    uint32_t mapChunks{4};
+    OrderPattern orders{OrderPattern::kRandom};
+    /// Ticks between two rounds of orders, 0 only gives orders once
+    uint32_t orderInterval{300};
+    uint32_t seed{1337};
+};
+
+struct GameConfig {
+    /// No window and no renderer. The fixed-step systems run back to back for
+    /// the given number of ticks and their timings are printed at the end.
+    bool headless{false};
+    uint32_t ticks{3600};
+    ScenarioConfig scenario;
+    RendererConfig renderer;
+    /// Writes the commands of every tick to this file, if set
+    std::string recordPath;
+    /// Rebuilds the world of this recording and runs its ticks as fast as
+    /// possible instead of reading input, then prints the system timings
+    std::string replayPath;
 };
 
+struct Prefab;
+
 class Game {
   public:
     Game();
-    void init();
+    void init(const GameConfig &config = GameConfig{});
     void deinit();
     void run();
+    /// Runs every fixed-step system once
+    void tick(float dt);
 
   private:
-    bool _isRunning{false};
+    GameConfig _config;
+    // NOTE: Cleared by the event thread to stop the simulation
+    std::atomic<bool> _isRunning{false};
     Arena _arena;
     World *_world;
+    FogOfWar *_fog;
     entt::registry _registry;
+    // NOTE: Structural changes made by systems, applied at sync points
+    CommandBuffer _commands;
+    SpatialGrid _grid;
+    math::DynamicBVH _bvh;
+    AvoidanceAgents _agents;
+    MoverArrays _movers;
+    HeadingArrays _headings;
+    SweepAndPrune _broadphase;
+    std::vector<CollisionPair> _collisionPairs;
+    // NOTE: Entities whose position changed during the current step
+    std::vector<entt::entity> _movedEntities;
+    TransformHierarchy _transforms;
+    // NOTE: Nodes whose world matrix changed during the current step, which
+    // includes the children of moved entities
+    std::vector<TransformHierarchy::Handle> _changedTransforms;
+    std::vector<glm::mat4> _movedMatrices;
+    std::vector<math::AABB> _movedBounds;
+    JobSystem _jobs;
     InputManager _input;
+    TickStats _tickStats;
+    std::mt19937 _scenarioRng;
+    // NOTE: Whether the world is a scenario, which gives its own orders
+    bool _isScenario{false};
+    // NOTE: Ticks run so far
+    uint32_t _tickIndex{0};
+    ReplayRecorder _recorder;
+    Replay _replay;
+    bool _isReplaying{false};
+    UnitArchetypes _archetypes;
+    // NOTE: Indexed by archetype
+    std::vector<Prefab> _prefabs;
+    Uint64 _archetypesCheckedAt{0};
+
+    // NOTE: Fixed-step systems, run once per tick
+    SystemScheduler _tickSystems{_registry};
+    // NOTE: Input handling and the snapshot for the render thread, run once
+    // per frame
+    SystemScheduler _frameSystems{_registry};
+    float _tickDt{0.f};
+    std::chrono::steady_clock::time_point _inputReadAt;
+    // NOTE: What the player asked for during the current tick, in window
+    // coordinates and then resolved against the camera. The tick only reads
+    // the resolved commands, so recording them is enough to replay it.
+    std::vector<InputCommand> _inputCommands;
+    std::vector<GameCommand> _tickCommands;
+    TimingRing _loopFrameTimes;
+    TimingRing _tickLateness;
+    uint64_t _droppedTicks{0};
+    LoopTimings _loopTimings;
+    // NOTE: Local bounds shared by every unit, from the mesh when rendering
+    std::optional<math::AABB> _unitBounds;
 
     Camera _camera;
     SDL_Window *_window;
     Renderer _renderer;
-    std::shared_ptr<Scene> _assets;
+    RenderThread _renderThread;
+    // NOTE: Filled by the frame systems, then handed to the render thread
+    std::shared_ptr<RenderSnapshot> _snapshot;
+    std::shared_ptr<const FogSnapshot> _fogSnapshot;
+    // NOTE: Every mesh an archetype uses, loaded once per path
+    std::vector<std::shared_ptr<Scene>> _meshes;
+    std::vector<std::string> _meshPaths;
 
+    void register_systems();
+    void connect_destroy_hooks();
+    void on_destroy_transform_node(entt::registry &registry,
+                                   entt::entity entity);
+    void on_destroy_bvh_proxy(entt::registry &registry, entt::entity entity);
+    void on_destroy_avoidance_agent(entt::registry &registry,
+                                    entt::entity entity);
+    void on_destroy_fog_viewer(entt::registry &registry, entt::entity entity);
     void update_positions(float dt);
+    void resolve_collisions();
+    void update_moved_entities();
+    void update_fog_of_war();
+
+    void pump_events();
+    void run_simulation();
+    void update_loop_timings();
 
-    void handle_pick_request();
-    void handle_move_request();
-    void render_entities();
+    void run_headless();
+    void init_scenario();
+    void give_scenario_orders();
+    glm::vec3 random_traversible_point();
+    glm::vec3 traversible_map_center();
+
+    void resolve_input_commands();
+    void take_replay_commands();
+    void handle_input_commands();
+    /// Replaces the selection with the first unit the ray hits, if any, and
+    /// returns whether it did
+    bool pick(const Ray &ray, std::vector<entt::entity> &selection);
+    /// Replaces the selection with the units inside the frustum
+    bool box_select(const math::Frustum &frustum,
+                    std::vector<entt::entity> &selection);
+    void order_move(glm::vec3 point, std::span<const entt::entity> selection);
+    void snapshot_units();
     void init_test_entities();
 
-    void add_entity(UnitType &&type, WorldPosition &&pos);
+    /// Rebuilds the prefabs and updates the units already spawned after
+    /// the archetypes changed
+    void apply_archetypes();
+    void load_archetype_meshes();
+    const Prefab &find_prefab(std::string_view name) const;
+    /// Spawns units of one type and team with a single create and one insert
+    /// per component
+    void spawn_batch(const Prefab &prefab,
+                     std::span<const WorldPosition> positions,
+                     uint8_t team = PLAYER_TEAM);
 
     Ray screen_point_to_ray(glm::vec2 &&point);
+    math::Frustum screen_rect_to_frustum(const glm::vec2 &start,
+                                         const glm::vec2 &end);
 };
 
 struct TargetPositionComponent {
@@ -61,11 +220,42 @@ struct MovementSpeed {
     float value;
 };
 
-struct UnitData {
-    std::string name;
-    float movementSpeed;
+struct AvoidanceAgent {
+    // NOTE: Velocity on the ground plane, y being world z
+    glm::vec2 velocity{0.f};
+    float radius;
+};
+
+struct Team {
+    uint8_t value;
+};
+
+struct BVHProxy {
+    int32_t node;
+};
+
+struct TransformNode {
+    TransformHierarchy::Handle handle;
+};
+
+struct FogViewer {
+    uint32_t radius;
+    // NOTE: Team and tile the viewer was last stamped at
+    uint8_t team;
+    int32_t tileX;
+    int32_t tileY;
+    bool isStamped{false};
+};
+
+/// The components every unit of an archetype spawns with, built once from
+/// its stats so spawning only copies them
+struct Prefab {
+    ArchetypeId archetype;
+    MovementSpeed movementSpeed;
+    AvoidanceAgent agent;
+    FogViewer fogViewer;
 
-    static const std::unordered_map<UnitType, UnitData> registry;
+    static Prefab from_archetype(ArchetypeId id, const ArchetypeStats &stats);
 };
 
 struct Selected {};
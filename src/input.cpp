@@ -1,68 +1,201 @@
 #include "input.h"
 #include <cstdio>
 
+enum class InputSource : uint8_t {
+    kKey,
+    kMouseButton,
+};
+
+struct InputBinding {
+    InputSource source;
+    uint32_t code;
+    InputActionType action;
+};
+
+static constexpr InputBinding kBindings[] = {
+    {InputSource::kKey, SDLK_W, PAN_UP},
+    {InputSource::kKey, SDLK_UP, PAN_UP},
+    {InputSource::kKey, SDLK_S, PAN_DOWN},
+    {InputSource::kKey, SDLK_DOWN, PAN_DOWN},
+    {InputSource::kKey, SDLK_A, PAN_LEFT},
+    {InputSource::kKey, SDLK_LEFT, PAN_LEFT},
+    {InputSource::kKey, SDLK_D, PAN_RIGHT},
+    {InputSource::kKey, SDLK_RIGHT, PAN_RIGHT},
+    {InputSource::kMouseButton, SDL_BUTTON_LEFT, SELECT},
+    {InputSource::kMouseButton, SDL_BUTTON_RIGHT, ORDER_MOVE},
+};
+
+static const InputBinding *find_binding(InputSource source, uint32_t code) {
+    for (const InputBinding &binding : kBindings) {
+        if (binding.source == source && binding.code == code) {
+            return &binding;
+        }
+    }
+    return nullptr;
+}
+
 InputManager::InputManager() {
     for (int i = 0; i < InputActionType::INPUT_ACTION_TYPE_COUNT; i++) {
         _inputStates[i] = false;
     }
 }
 
-void InputManager::update() { SDL_GetMouseState(&_mousePos.x, &_mousePos.y); }
-
-void InputManager::reset() {
-    _scrollDelta = 0.0f;
-    _hasPendingPickRequest = false;
-    _hasRightClickRequest = false;
-}
+void InputManager::reset() { _scrollDelta = 0.0f; }
 
-void InputManager::process_event(const SDL_Event &event) {
+void InputManager::queue_event(const SDL_Event &event) {
+    InputEvent queued{};
+    queued.timestamp = event.common.timestamp;
     switch (event.type) {
-    case SDL_EVENT_KEY_DOWN: {
-        switch (event.key.key) {
-        case SDLK_UP:
-        case SDLK_W: {
-            _inputStates[InputActionType::PAN_Y] = true;
-            break;
-        } // END W SWITCH
-        } // END KEY SWITCH
-        break;
-    } // END DOWN SWITCH
+    case SDL_EVENT_KEY_DOWN:
     case SDL_EVENT_KEY_UP: {
-        switch (event.key.key) {
-        case SDLK_UP:
-        case SDLK_W: {
-            _inputStates[InputActionType::PAN_Y] = false;
-            break;
-        } // END W SWITCH
-        } // END KEY SWITCH
-        break;
-    } // END UP SWITCH
-    case SDL_EVENT_MOUSE_BUTTON_DOWN: {
-        switch (event.button.button) {
-        case SDL_BUTTON_LEFT: {
-            process_left_click({(float)event.button.x, (float)event.button.y});
-            break;
-        }
-        case SDL_BUTTON_RIGHT: {
-            process_right_click({(float)event.button.x, (float)event.button.y});
-            break;
-        }
+        // NOTE: Held keys only matter when they go down and up
+        if (event.key.repeat) {
+            return;
         }
+        queued.type = event.type == SDL_EVENT_KEY_DOWN
+                          ? InputEventType::kKeyDown
+                          : InputEventType::kKeyUp;
+        queued.code = event.key.key;
+        break;
+    }
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP: {
+        queued.type = event.type == SDL_EVENT_MOUSE_BUTTON_DOWN
+                          ? InputEventType::kButtonDown
+                          : InputEventType::kButtonUp;
+        queued.code = event.button.button;
+        queued.value = glm::vec2(event.button.x, event.button.y);
+        break;
+    }
+    case SDL_EVENT_MOUSE_MOTION: {
+        queued.type = InputEventType::kMouseMotion;
+        queued.value = glm::vec2(event.motion.x, event.motion.y);
         break;
     }
     case SDL_EVENT_MOUSE_WHEEL: {
-        _scrollDelta += event.wheel.y;
+        queued.type = InputEventType::kWheel;
+        queued.value = glm::vec2(0.f, event.wheel.y);
         break;
     }
+    default:
+        return;
     } // END TYPE SWITCH
+
+    queue(queued);
+}
+
+void InputManager::queue_resize(uint64_t timestamp, glm::vec2 size) {
+    queue(InputEvent{timestamp, InputEventType::kResize, 0, size});
+}
+
+void InputManager::queue(const InputEvent &event) {
+    // NOTE: Only happens when the simulation stalls for seconds
+    if (!_queue.push(event)) {
+        fprintf(stderr, "input queue full, dropped an event\n");
+    }
+}
+
+void InputManager::consume(uint64_t time,
+                           std::vector<InputCommand> &commands) {
+    while (const InputEvent *event = _queue.peek()) {
+        if (event->timestamp > time) {
+            break;
+        }
+        apply(*event, commands);
+        _queue.pop();
+    }
+}
+
+std::optional<glm::vec2> InputManager::take_resize() {
+    std::optional<glm::vec2> size = _resize;
+    _resize.reset();
+    return size;
+}
+
+void InputManager::apply(const InputEvent &event,
+                         std::vector<InputCommand> &commands) {
+    switch (event.type) {
+    case InputEventType::kMouseMotion: {
+        _mousePos = event.value;
+        return;
+    }
+    case InputEventType::kWheel: {
+        _scrollDelta += event.value.y;
+        return;
+    }
+    case InputEventType::kResize: {
+        _resize = event.value;
+        return;
+    }
+    case InputEventType::kButtonDown:
+    case InputEventType::kButtonUp: {
+        _mousePos = event.value;
+        break;
+    }
+    case InputEventType::kKeyDown:
+    case InputEventType::kKeyUp:
+        break;
+    } // END TYPE SWITCH
+
+    bool isKey = event.type == InputEventType::kKeyDown ||
+                 event.type == InputEventType::kKeyUp;
+    const InputBinding *binding = find_binding(
+        isKey ? InputSource::kKey : InputSource::kMouseButton, event.code);
+    if (binding == nullptr) {
+        return;
+    }
+
+    bool isDown = event.type == InputEventType::kKeyDown ||
+                  event.type == InputEventType::kButtonDown;
+    if (isDown && !_inputStates[binding->action]) {
+        _inputStates[binding->action] = true;
+        press(binding->action, commands);
+    } else if (!isDown && _inputStates[binding->action]) {
+        _inputStates[binding->action] = false;
+        release(binding->action, commands);
+    }
+}
+
+void InputManager::press(InputActionType action,
+                         std::vector<InputCommand> &commands) {
+    switch (action) {
+    case SELECT: {
+        _leftDragStartPos = _mousePos;
+        break;
+    }
+    case ORDER_MOVE: {
+        commands.push_back(
+            InputCommand{InputCommandType::kMove, _mousePos, _mousePos});
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void InputManager::release(InputActionType action,
+                           std::vector<InputCommand> &commands) {
+    if (action != SELECT) {
+        return;
+    }
+
+    // NOTE: Picking happens on release so a press can still turn into a drag
+    if (!is_box_drag()) {
+        commands.push_back(
+            InputCommand{InputCommandType::kPick, _mousePos, _mousePos});
+    } else {
+        commands.push_back(InputCommand{InputCommandType::kBoxSelect,
+                                        _leftDragStartPos, _mousePos});
+    }
 }
 
-void InputManager::process_left_click(glm::vec2 &&clickPos) {
-    _hasPendingPickRequest = true;
-    _lastLeftClickPos = clickPos;
+bool InputManager::isBoxSelecting() {
+    return _inputStates[SELECT] && is_box_drag();
 }
 
-void InputManager::process_right_click(glm::vec2 &&clickPos) {
-    _hasRightClickRequest = true;
-    _lastRightClickPos = clickPos;
+// NOTE: A box with no width or height has no volume to select in, so both
+// sides must be long enough, not just the diagonal
+bool InputManager::is_box_drag() const {
+    glm::vec2 extent = glm::abs(_mousePos - _leftDragStartPos);
+    return extent.x >= kBoxSelectThreshold && extent.y >= kBoxSelectThreshold;
 }
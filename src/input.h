@@ -1,38 +1,81 @@
 #pragma once
+#include "input_queue.h"
 #include <SDL3/SDL_events.h>
 #include <array>
 #include <glm/glm.hpp>
+#include <optional>
+#include <vector>
 
 enum InputActionType {
-    PAN_X,
-    PAN_Y,
+    PAN_UP,
+    PAN_DOWN,
+    PAN_LEFT,
+    PAN_RIGHT,
+    SELECT,
+    ORDER_MOVE,
     INPUT_ACTION_TYPE_COUNT,
 };
 
+enum class InputCommandType : uint8_t {
+    kPick,
+    kBoxSelect,
+    kMove,
+};
+
+/// Something the player asked for, in window coordinates. A box selection
+/// spans start to end, the others only use start.
+struct InputCommand {
+    InputCommandType type;
+    glm::vec2 start;
+    glm::vec2 end;
+};
+
+/// Turns SDL events into actions through a table of bindings, and actions
+/// into commands for the simulation. Events are queued with their SDL
+/// timestamp by the thread that polls them, and applied by the tick whose
+/// time they fall in, so every click of a frame is kept and gets the same
+/// tick however late the frame runs.
 class InputManager {
   public:
     InputManager();
-    void process_event(const SDL_Event &event);
-    bool is_active(InputActionType type);
-    void update();
+
+    /// Event thread. Skips the events the game does not read.
+    void queue_event(const SDL_Event &event);
+    /// Event thread. size is the new window size in pixels.
+    void queue_resize(uint64_t timestamp, glm::vec2 size);
+    /// Before the simulation starts. Motion events only come once the mouse
+    /// moves, so this is where it is until then.
+    void set_mouse_position(glm::vec2 position) { _mousePos = position; }
+
+    /// Simulation thread. Applies the queued events up to and including
+    /// time and appends the commands they make.
+    void consume(uint64_t time, std::vector<InputCommand> &commands);
+    /// The window size of the last resize consumed, once
+    std::optional<glm::vec2> take_resize();
+    /// Clears what accumulates between frames
     void reset();
 
+    bool is_active(InputActionType type) { return _inputStates[type]; }
     glm::vec2 mousePos() { return _mousePos; };
     float scrollDelta() { return _scrollDelta; };
-    bool hasPendingPickRequest() { return _hasPendingPickRequest; };
-    bool hasRightClickRequest() { return _hasRightClickRequest; };
-    glm::vec2 lastLeftClickPos() { return _lastLeftClickPos; };
-    glm::vec2 lastRightClickPos() { return _lastRightClickPos; };
+    glm::vec2 leftDragStartPos() { return _leftDragStartPos; };
+    bool isBoxSelecting();
 
   private:
+    InputEventQueue _queue;
     std::array<bool, InputActionType::INPUT_ACTION_TYPE_COUNT> _inputStates;
     glm::vec2 _mousePos{0.0f, 0.0f};
     float _scrollDelta{0.0f};
-    bool _hasPendingPickRequest{false};
-    bool _hasRightClickRequest{false};
-    glm::vec2 _lastLeftClickPos{0.0f, 0.0f};
-    glm::vec2 _lastRightClickPos{0.0f, 0.0f};
+    glm::vec2 _leftDragStartPos{0.0f, 0.0f};
+    std::optional<glm::vec2> _resize;
+
+    // NOTE: Drags less than this many pixels wide or high count as a click
+    static constexpr float kBoxSelectThreshold = 4.f;
 
-    void process_left_click(glm::vec2 &&clickPos);
-    void process_right_click(glm::vec2 &&clickPos);
+    bool is_box_drag() const;
+    void queue(const InputEvent &event);
+    void apply(const InputEvent &event, std::vector<InputCommand> &commands);
+    void press(InputActionType action, std::vector<InputCommand> &commands);
+    void release(InputActionType action,
+                 std::vector<InputCommand> &commands);
 };
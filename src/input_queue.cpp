@@ -0,0 +1,31 @@
+#include "input_queue.h"
+
+bool InputEventQueue::push(const InputEvent &event) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _producerHead == kCapacity) {
+        _producerHead = _head.load(std::memory_order_acquire);
+        if (tail - _producerHead == kCapacity) {
+            return false;
+        }
+    }
+
+    _events[tail & kMask] = event;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+const InputEvent *InputEventQueue::peek() {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head == _consumerTail) {
+        _consumerTail = _tail.load(std::memory_order_acquire);
+        if (head == _consumerTail) {
+            return nullptr;
+        }
+    }
+    return &_events[head & kMask];
+}
+
+void InputEventQueue::pop() {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    _head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/vec2.hpp>
+
+enum class InputEventType : uint8_t {
+    kMouseMotion,
+    kButtonDown,
+    kButtonUp,
+    kKeyDown,
+    kKeyUp,
+    kWheel,
+    kResize,
+};
+
+/// An input event stripped down to what the game reads
+struct InputEvent {
+    /// Nanoseconds on the SDL_GetTicksNS clock
+    uint64_t timestamp;
+    InputEventType type;
+    /// Mouse button or keycode
+    uint32_t code;
+    /// Mouse position, wheel delta in y, or window size in pixels
+    glm::vec2 value;
+};
+
+/// Bounded ring with one thread pushing and another popping, neither of
+/// which ever waits on the other
+class InputEventQueue {
+  public:
+    static constexpr uint32_t kCapacity = 1024;
+
+    /// Producer only. Fails when full.
+    bool push(const InputEvent &event);
+    /// Consumer only. The oldest event, null when empty.
+    const InputEvent *peek();
+    /// Consumer only, drops the event peek returned
+    void pop();
+
+  private:
+    static constexpr uint32_t kMask = kCapacity - 1;
+    static_assert((kCapacity & kMask) == 0);
+
+    // NOTE: Both indices only grow and wrap around together with uint32_t
+    alignas(64) std::atomic<uint32_t> _head{0};
+    alignas(64) std::atomic<uint32_t> _tail{0};
+    // NOTE: Each side keeps the last index it read from the other and only
+    // reads it again when the ring looks full or empty
+    alignas(64) uint32_t _producerHead{0};
+    alignas(64) uint32_t _consumerTail{0};
+    std::array<InputEvent, kCapacity> _events;
+};
@@ -1,8 +1,94 @@
 #include "game.h"
+#include <cstdlib>
+#include <cstring>
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [--headless] [--ticks N] [--entities N] "
+            "[--map-chunks N]\n"
+            "          [--orders idle|random|converge|swap] "
+            "[--order-interval N] [--seed N]\n"
+            "          [--frames-in-flight 2|3] [--low-latency]\n"
+            "          [--record FILE] [--replay FILE]\n",
+            program);
+}
+
+static bool parse_orders(const char *value, OrderPattern &out) {
+    if (strcmp(value, "idle") == 0) {
+        out = OrderPattern::kIdle;
+    } else if (strcmp(value, "random") == 0) {
+        out = OrderPattern::kRandom;
+    } else if (strcmp(value, "converge") == 0) {
+        out = OrderPattern::kConverge;
+    } else if (strcmp(value, "swap") == 0) {
+        out = OrderPattern::kSwap;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_config(int argc, char *args[], GameConfig &config) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = args[i];
+        if (strcmp(arg, "--headless") == 0) {
+            config.headless = true;
+            continue;
+        }
+        if (strcmp(arg, "--low-latency") == 0) {
+            config.renderer.frameMode = FrameMode::kLowLatency;
+            continue;
+        }
+
+        // NOTE: Every other option takes a value
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = args[++i];
+        uint32_t number = (uint32_t)strtoul(value, nullptr, 10);
+
+        if (strcmp(arg, "--ticks") == 0) {
+            config.ticks = number;
+        } else if (strcmp(arg, "--entities") == 0) {
+            config.scenario.entityCount = number;
+        } else if (strcmp(arg, "--map-chunks") == 0) {
+            if (number == 0) {
+                return false;
+            }
+            config.scenario.mapChunks = number;
+        } else if (strcmp(arg, "--orders") == 0) {
+            if (!parse_orders(value, config.scenario.orders)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--order-interval") == 0) {
+            config.scenario.orderInterval = number;
+        } else if (strcmp(arg, "--seed") == 0) {
+            config.scenario.seed = number;
+        } else if (strcmp(arg, "--frames-in-flight") == 0) {
+            if (number < 2 || number > MAX_FRAME_OVERLAP) {
+                return false;
+            }
+            config.renderer.frameOverlap = number;
+        } else if (strcmp(arg, "--record") == 0) {
+            config.recordPath = value;
+        } else if (strcmp(arg, "--replay") == 0) {
+            config.replayPath = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
 
 int main(int argc, char *args[]) {
+    GameConfig config;
+    if (!parse_config(argc, args, config)) {
+        print_usage(args[0]);
+        return 1;
+    }
+
     Game game;
-    game.init();
+    game.init(config);
     game.run();
     game.deinit();
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cassert>
 #include <glm/glm.hpp>
 
 namespace math {
@@ -13,7 +14,27 @@ struct AABB {
         max = glm::max(max, other.max);
     }
 
+    /// Transforms the center and folds the extents through the absolute value
+    /// of the linear part (Arvo), which is exact for affine matrices and
+    /// needs no divides
     AABB transform(const glm::mat4 &matrix) const {
+        assert(matrix[0][3] == 0.f && matrix[1][3] == 0.f &&
+               matrix[2][3] == 0.f && matrix[3][3] == 1.f);
+
+        glm::vec3 center = (min + max) * 0.5f;
+        glm::vec3 extents = (max - min) * 0.5f;
+
+        glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center, 1.f));
+        glm::vec3 newExtents = glm::abs(glm::vec3(matrix[0])) * extents.x +
+                               glm::abs(glm::vec3(matrix[1])) * extents.y +
+                               glm::abs(glm::vec3(matrix[2])) * extents.z;
+
+        return AABB{newCenter - newExtents, newCenter + newExtents};
+    }
+
+    /// Transforms all 8 corners with a perspective divide. Only needed when
+    /// the matrix has a projective part.
+    AABB transform_projective(const glm::mat4 &matrix) const {
         glm::vec3 corners[8] = {
             glm::vec3(min.x, min.y, min.z), glm::vec3(max.x, min.y, min.z),
             glm::vec3(min.x, max.y, min.z), glm::vec3(min.x, min.y, max.z),
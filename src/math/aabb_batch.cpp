@@ -0,0 +1,69 @@
+#include "aabb_batch.h"
+#include <immintrin.h>
+
+void math::AABBArrays::resize(size_t count) {
+    centerX.resize(count);
+    centerY.resize(count);
+    centerZ.resize(count);
+    extentX.resize(count);
+    extentY.resize(count);
+    extentZ.resize(count);
+}
+
+void math::AABBArrays::set(size_t index, const AABB &aabb) {
+    glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 extents = (aabb.max - aabb.min) * 0.5f;
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extents.x;
+    extentY[index] = extents.y;
+    extentZ[index] = extents.z;
+}
+
+math::AABB math::AABBArrays::get(size_t index) const {
+    glm::vec3 center{centerX[index], centerY[index], centerZ[index]};
+    glm::vec3 extents{extentX[index], extentY[index], extentZ[index]};
+    return AABB{center - extents, center + extents};
+}
+
+void math::transform_aabb_instances(const AABB &aabb,
+                                    std::span<const glm::mat4> matrices,
+                                    std::span<AABB> out) {
+    assert(out.size() >= matrices.size());
+
+    glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 extents = (aabb.max - aabb.min) * 0.5f;
+    __m128 cx = _mm_set1_ps(center.x);
+    __m128 cy = _mm_set1_ps(center.y);
+    __m128 cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extents.x);
+    __m128 ey = _mm_set1_ps(extents.y);
+    __m128 ez = _mm_set1_ps(extents.z);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    for (size_t i = 0; i < matrices.size(); i++) {
+        // NOTE: Each column of the matrix fills one register, the w lane
+        // comes along for the ride and is dropped on store
+        const float *m = &matrices[i][0][0];
+        __m128 c0 = _mm_loadu_ps(m + 0);
+        __m128 c1 = _mm_loadu_ps(m + 4);
+        __m128 c2 = _mm_loadu_ps(m + 8);
+        __m128 c3 = _mm_loadu_ps(m + 12);
+
+        __m128 newCenter =
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, cx), _mm_mul_ps(c1, cy)),
+                       _mm_add_ps(_mm_mul_ps(c2, cz), c3));
+        __m128 newExtents = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_and_ps(c0, absMask), ex),
+                       _mm_mul_ps(_mm_and_ps(c1, absMask), ey)),
+            _mm_mul_ps(_mm_and_ps(c2, absMask), ez));
+
+        alignas(16) float lo[4];
+        alignas(16) float hi[4];
+        _mm_store_ps(lo, _mm_sub_ps(newCenter, newExtents));
+        _mm_store_ps(hi, _mm_add_ps(newCenter, newExtents));
+        out[i] = AABB{glm::vec3(lo[0], lo[1], lo[2]),
+                      glm::vec3(hi[0], hi[1], hi[2])};
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "aabb.h"
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace math {
+/// AABBs in center and extents form with one array per component, so a SIMD
+/// register holds the same component of several boxes
+struct AABBArrays {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+
+    size_t size() const { return centerX.size(); }
+    void resize(size_t count);
+    void set(size_t index, const AABB &aabb);
+    AABB get(size_t index) const;
+};
+
+/// Transforms one box by many affine matrices, e.g. the local bounds of a
+/// mesh by the world matrix of every entity using it
+void transform_aabb_instances(const AABB &aabb,
+                              std::span<const glm::mat4> matrices,
+                              std::span<AABB> out);
+} // namespace math
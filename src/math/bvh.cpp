@@ -0,0 +1,277 @@
+#include "bvh.h"
+#include <algorithm>
+
+int32_t math::DynamicBVH::allocate_node() {
+    if (_freeList == kNullNode) {
+        _nodes.push_back(Node{});
+        _freeList = (int32_t)_nodes.size() - 1;
+        _nodes[_freeList].parent = kNullNode;
+    }
+
+    int32_t index = _freeList;
+    // NOTE: Free nodes are chained through their parent index
+    _freeList = _nodes[index].parent;
+    _nodes[index].parent = kNullNode;
+    _nodes[index].child1 = kNullNode;
+    _nodes[index].child2 = kNullNode;
+    _nodes[index].userData = 0;
+    return index;
+}
+
+void math::DynamicBVH::free_node(int32_t index) {
+    _nodes[index].parent = _freeList;
+    _freeList = index;
+}
+
+void math::DynamicBVH::clear() {
+    _nodes.clear();
+    _root = kNullNode;
+    _freeList = kNullNode;
+}
+
+int32_t math::DynamicBVH::insert(const AABB &aabb, uint32_t userData) {
+    int32_t leaf = allocate_node();
+    _nodes[leaf].aabb = AABB{aabb.min - _margin, aabb.max + _margin};
+    _nodes[leaf].userData = userData;
+    insert_leaf(leaf);
+    return leaf;
+}
+
+void math::DynamicBVH::remove(int32_t proxy) {
+    assert(_nodes[proxy].is_leaf());
+    remove_leaf(proxy);
+    free_node(proxy);
+}
+
+bool math::DynamicBVH::move(int32_t proxy, const AABB &aabb) {
+    assert(_nodes[proxy].is_leaf());
+    const AABB &fat = _nodes[proxy].aabb;
+    if (fat.min.x <= aabb.min.x && fat.min.y <= aabb.min.y &&
+        fat.min.z <= aabb.min.z && aabb.max.x <= fat.max.x &&
+        aabb.max.y <= fat.max.y && aabb.max.z <= fat.max.z) {
+        return false;
+    }
+
+    remove_leaf(proxy);
+    _nodes[proxy].aabb = AABB{aabb.min - _margin, aabb.max + _margin};
+    insert_leaf(proxy);
+    return true;
+}
+
+/**
+ * @brief Branch and bound search for the node that adds the least surface
+ *        area when the new leaf is paired with it. The cost of pairing with a
+ *        node is the area of the new parent plus the area every ancestor
+ *        grows by.
+ */
+int32_t math::DynamicBVH::find_best_sibling(const AABB &aabb) const {
+    float leafArea = surface_area(aabb);
+
+    int32_t best = _root;
+    float bestCost = surface_area(merged(_nodes[_root].aabb, aabb));
+
+    struct Candidate {
+        int32_t node;
+        float inheritedCost;
+    };
+    static thread_local std::vector<Candidate> stack;
+    stack.clear();
+    stack.push_back({_root, 0.f});
+
+    while (!stack.empty()) {
+        Candidate candidate = stack.back();
+        stack.pop_back();
+
+        const Node &node = _nodes[candidate.node];
+        float directCost = surface_area(merged(node.aabb, aabb));
+        float cost = directCost + candidate.inheritedCost;
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = candidate.node;
+        }
+
+        if (node.is_leaf()) {
+            continue;
+        }
+
+        float inheritedCost =
+            candidate.inheritedCost + directCost - surface_area(node.aabb);
+        if (leafArea + inheritedCost < bestCost) {
+            stack.push_back({node.child1, inheritedCost});
+            stack.push_back({node.child2, inheritedCost});
+        }
+    }
+
+    return best;
+}
+
+void math::DynamicBVH::insert_leaf(int32_t leaf) {
+    if (_root == kNullNode) {
+        _root = leaf;
+        _nodes[leaf].parent = kNullNode;
+        return;
+    }
+
+    int32_t sibling = find_best_sibling(_nodes[leaf].aabb);
+
+    int32_t oldParent = _nodes[sibling].parent;
+    int32_t newParent = allocate_node();
+    _nodes[newParent].parent = oldParent;
+    _nodes[newParent].aabb = merged(_nodes[leaf].aabb, _nodes[sibling].aabb);
+    _nodes[newParent].child1 = sibling;
+    _nodes[newParent].child2 = leaf;
+    _nodes[sibling].parent = newParent;
+    _nodes[leaf].parent = newParent;
+
+    if (oldParent == kNullNode) {
+        _root = newParent;
+    } else if (_nodes[oldParent].child1 == sibling) {
+        _nodes[oldParent].child1 = newParent;
+    } else {
+        _nodes[oldParent].child2 = newParent;
+    }
+
+    refit_ancestors(_nodes[leaf].parent);
+}
+
+void math::DynamicBVH::remove_leaf(int32_t leaf) {
+    if (leaf == _root) {
+        _root = kNullNode;
+        return;
+    }
+
+    int32_t parent = _nodes[leaf].parent;
+    int32_t grandParent = _nodes[parent].parent;
+    int32_t sibling = _nodes[parent].child1 == leaf ? _nodes[parent].child2
+                                                    : _nodes[parent].child1;
+
+    free_node(parent);
+    _nodes[sibling].parent = grandParent;
+
+    if (grandParent == kNullNode) {
+        _root = sibling;
+        return;
+    }
+
+    if (_nodes[grandParent].child1 == parent) {
+        _nodes[grandParent].child1 = sibling;
+    } else {
+        _nodes[grandParent].child2 = sibling;
+    }
+    refit_ancestors(grandParent);
+}
+
+void math::DynamicBVH::refit_ancestors(int32_t index) {
+    while (index != kNullNode) {
+        Node &node = _nodes[index];
+        node.aabb = merged(_nodes[node.child1].aabb, _nodes[node.child2].aabb);
+        rotate(index);
+        index = _nodes[index].parent;
+    }
+}
+
+/**
+ * @brief Swaps a child of the node with one of its grandchildren when that
+ *        shrinks the surface area of the child that gets the grandchild.
+ *        The area of the node itself stays the same, so this only ever makes
+ *        the tree cheaper to traverse.
+ */
+void math::DynamicBVH::rotate(int32_t index) {
+    Node &a = _nodes[index];
+    int32_t b = a.child1;
+    int32_t c = a.child2;
+
+    enum class Rotation { None, BF, BG, CD, CE };
+    Rotation bestRotation = Rotation::None;
+    float bestDiff = 0.f;
+
+    if (!_nodes[c].is_leaf()) {
+        // NOTE: Swapping B with a child of C only changes the area of C
+        float areaC = surface_area(_nodes[c].aabb);
+        int32_t f = _nodes[c].child1;
+        int32_t g = _nodes[c].child2;
+
+        float diffBF =
+            surface_area(merged(_nodes[b].aabb, _nodes[g].aabb)) - areaC;
+        if (diffBF < bestDiff) {
+            bestRotation = Rotation::BF;
+            bestDiff = diffBF;
+        }
+        float diffBG =
+            surface_area(merged(_nodes[b].aabb, _nodes[f].aabb)) - areaC;
+        if (diffBG < bestDiff) {
+            bestRotation = Rotation::BG;
+            bestDiff = diffBG;
+        }
+    }
+
+    if (!_nodes[b].is_leaf()) {
+        float areaB = surface_area(_nodes[b].aabb);
+        int32_t d = _nodes[b].child1;
+        int32_t e = _nodes[b].child2;
+
+        float diffCD =
+            surface_area(merged(_nodes[c].aabb, _nodes[e].aabb)) - areaB;
+        if (diffCD < bestDiff) {
+            bestRotation = Rotation::CD;
+            bestDiff = diffCD;
+        }
+        float diffCE =
+            surface_area(merged(_nodes[c].aabb, _nodes[d].aabb)) - areaB;
+        if (diffCE < bestDiff) {
+            bestRotation = Rotation::CE;
+            bestDiff = diffCE;
+        }
+    }
+
+    auto swap = [this, index](int32_t child, int32_t parent,
+                              int32_t grandChild) {
+        // NOTE: child is a child of index, grandChild a child of parent
+        Node &p = _nodes[parent];
+        if (p.child1 == grandChild) {
+            p.child1 = child;
+        } else {
+            p.child2 = child;
+        }
+        if (_nodes[index].child1 == child) {
+            _nodes[index].child1 = grandChild;
+        } else {
+            _nodes[index].child2 = grandChild;
+        }
+        _nodes[child].parent = parent;
+        _nodes[grandChild].parent = index;
+        p.aabb = merged(_nodes[p.child1].aabb, _nodes[p.child2].aabb);
+    };
+
+    switch (bestRotation) {
+    case Rotation::None:
+        break;
+    case Rotation::BF:
+        swap(b, c, _nodes[c].child1);
+        break;
+    case Rotation::BG:
+        swap(b, c, _nodes[c].child2);
+        break;
+    case Rotation::CD:
+        swap(c, b, _nodes[b].child1);
+        break;
+    case Rotation::CE:
+        swap(c, b, _nodes[b].child2);
+        break;
+    }
+}
+
+int32_t math::DynamicBVH::node_height(int32_t index) const {
+    const Node &node = _nodes[index];
+    if (node.is_leaf()) {
+        return 0;
+    }
+    return 1 + std::max(node_height(node.child1), node_height(node.child2));
+}
+
+int32_t math::DynamicBVH::height() const {
+    if (_root == kNullNode) {
+        return 0;
+    }
+    return node_height(_root);
+}
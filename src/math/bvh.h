@@ -0,0 +1,218 @@
+#pragma once
+#include "aabb.h"
+#include "frustum.h"
+#include "intersection.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace math {
+/// Dynamic bounding volume hierarchy over AABBs. Leaves are inserted next to
+/// the sibling that adds the least surface area, and every ancestor is
+/// refitted and rotated on the way back up to keep the tree shallow.
+/// Leaves store a fattened AABB so small moves do not touch the tree.
+class DynamicBVH {
+  public:
+    static constexpr int32_t kNullNode = -1;
+
+    explicit DynamicBVH(float margin = 0.25f) : _margin(margin) {}
+
+    int32_t insert(const AABB &aabb, uint32_t userData);
+    void remove(int32_t proxy);
+    /// Returns true if the proxy left its fat AABB and had to be reinserted
+    bool move(int32_t proxy, const AABB &aabb);
+    void clear();
+
+    uint32_t user_data(int32_t proxy) const { return _nodes[proxy].userData; }
+    const AABB &fat_aabb(int32_t proxy) const { return _nodes[proxy].aabb; }
+    int32_t height() const;
+
+    /// Calls callback(userData) for every leaf overlapping the AABB
+    template <typename F> void query(const AABB &aabb, F &&callback) const;
+    /// Calls callback(userData) for every leaf overlapping the frustum.
+    /// Subtrees fully inside the frustum are reported without further tests.
+    template <typename F>
+    void query(const Frustum &frustum, F &&callback) const;
+
+    /// Finds the closest leaf hit by the ray. callback(userData, maxDistance)
+    /// does the exact test and returns the hit distance along the ray, or a
+    /// negative value on a miss. Subtrees further away than the closest hit
+    /// so far are skipped.
+    template <typename F>
+    bool raycast(const Ray &ray, F &&callback, float &outDistance,
+                 uint32_t &outUserData) const;
+
+  private:
+    struct Node {
+        AABB aabb;
+        int32_t parent;
+        int32_t child1;
+        int32_t child2;
+        uint32_t userData;
+
+        bool is_leaf() const { return child1 == kNullNode; }
+    };
+
+    std::vector<Node> _nodes;
+    int32_t _root{kNullNode};
+    int32_t _freeList{kNullNode};
+    float _margin;
+
+    int32_t allocate_node();
+    void free_node(int32_t index);
+    void insert_leaf(int32_t leaf);
+    void remove_leaf(int32_t leaf);
+    int32_t find_best_sibling(const AABB &aabb) const;
+    void refit_ancestors(int32_t index);
+    void rotate(int32_t index);
+    int32_t node_height(int32_t index) const;
+};
+
+inline float surface_area(const AABB &aabb) {
+    glm::vec3 d = aabb.max - aabb.min;
+    return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+inline AABB merged(const AABB &a, const AABB &b) {
+    return AABB{glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+inline bool overlaps(const AABB &a, const AABB &b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y &&
+           a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+template <typename F>
+void DynamicBVH::query(const AABB &aabb, F &&callback) const {
+    if (_root == kNullNode) {
+        return;
+    }
+
+    static thread_local std::vector<int32_t> stack;
+    stack.clear();
+    stack.push_back(_root);
+
+    while (!stack.empty()) {
+        const Node &node = _nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(node.aabb, aabb)) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            callback(node.userData);
+        } else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+template <typename F>
+void DynamicBVH::query(const Frustum &frustum, F &&callback) const {
+    if (_root == kNullNode) {
+        return;
+    }
+
+    struct StackEntry {
+        int32_t node;
+        bool isInside;
+    };
+    static thread_local std::vector<StackEntry> stack;
+    stack.clear();
+    stack.push_back({_root, false});
+
+    while (!stack.empty()) {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+        const Node &node = _nodes[entry.node];
+
+        bool isInside = entry.isInside;
+        if (!isInside) {
+            Containment containment = classify_frustum_aabb(frustum, node.aabb);
+            if (containment == Containment::kOutside) {
+                continue;
+            }
+            isInside = containment == Containment::kInside;
+        }
+
+        if (node.is_leaf()) {
+            callback(node.userData);
+        } else {
+            stack.push_back({node.child1, isInside});
+            stack.push_back({node.child2, isInside});
+        }
+    }
+}
+
+template <typename F>
+bool DynamicBVH::raycast(const Ray &ray, F &&callback, float &outDistance,
+                         uint32_t &outUserData) const {
+    if (_root == kNullNode) {
+        return false;
+    }
+
+    float closest = std::numeric_limits<float>::max();
+    bool hasHit = false;
+
+    // NOTE: Every node test reuses the reciprocal direction
+    RayPacket packet(ray);
+    float rootDistance;
+    if (!intersect_ray_aabb(packet, _nodes[_root].aabb, closest,
+                            rootDistance)) {
+        return false;
+    }
+
+    struct StackEntry {
+        int32_t node;
+        float distance;
+    };
+    static thread_local std::vector<StackEntry> stack;
+    stack.clear();
+    stack.push_back({_root, rootDistance});
+
+    while (!stack.empty()) {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+        if (entry.distance > closest) {
+            continue;
+        }
+
+        const Node &node = _nodes[entry.node];
+        if (node.is_leaf()) {
+            float distance = callback(node.userData, closest);
+            if (distance >= 0.f && distance < closest) {
+                closest = distance;
+                outUserData = node.userData;
+                hasHit = true;
+            }
+            continue;
+        }
+
+        float distance1, distance2;
+        bool hit1 = intersect_ray_aabb(packet, _nodes[node.child1].aabb,
+                                       closest, distance1);
+        bool hit2 = intersect_ray_aabb(packet, _nodes[node.child2].aabb,
+                                       closest, distance2);
+
+        // NOTE: Push the further child first so the nearer one is visited
+        // first and tightens the closest distance early
+        if (hit1 && hit2 && distance1 < distance2) {
+            stack.push_back({node.child2, distance2});
+            stack.push_back({node.child1, distance1});
+        } else {
+            if (hit1) {
+                stack.push_back({node.child1, distance1});
+            }
+            if (hit2) {
+                stack.push_back({node.child2, distance2});
+            }
+        }
+    }
+
+    if (hasHit) {
+        outDistance = closest;
+    }
+    return hasHit;
+}
+} // namespace math
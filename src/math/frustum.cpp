@@ -0,0 +1,89 @@
+#include "frustum.h"
+
+static glm::vec4 plane_from_points(const glm::vec3 &a, const glm::vec3 &b,
+                                   const glm::vec3 &c,
+                                   const glm::vec3 &inside) {
+    glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+    glm::vec4 plane = glm::vec4(normal, -glm::dot(normal, a));
+    // NOTE: Flip the plane instead of relying on the winding of the corners
+    if (glm::dot(normal, inside) + plane.w < 0.f) {
+        plane = -plane;
+    }
+    return plane;
+}
+
+math::Frustum
+math::frustum_from_corners(const std::array<glm::vec3, 4> &nearCorners,
+                           const std::array<glm::vec3, 4> &farCorners) {
+    glm::vec3 center{0.f};
+    for (int i = 0; i < 4; i++) {
+        center += nearCorners[i] + farCorners[i];
+    }
+    center /= 8.f;
+
+    Frustum frustum;
+    frustum.planes[0] = plane_from_points(nearCorners[0], nearCorners[1],
+                                          nearCorners[2], center);
+    frustum.planes[1] = plane_from_points(farCorners[0], farCorners[1],
+                                          farCorners[2], center);
+    for (int i = 0; i < 4; i++) {
+        int next = (i + 1) % 4;
+        frustum.planes[2 + i] = plane_from_points(
+            nearCorners[i], nearCorners[next], farCorners[i], center);
+    }
+    return frustum;
+}
+
+math::Frustum math::frustum_from_matrix(const glm::mat4 &viewproj) {
+    // NOTE: glm is column major, so rows have to be gathered by hand
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewproj[0][i], viewproj[1][i], viewproj[2][i],
+                            viewproj[3][i]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    for (glm::vec4 &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+/**
+ * @brief Tests the box corner furthest along each plane normal against it.
+ *        If that corner is behind any plane the box is outside, and if the
+ *        nearest corner is in front of every plane the box is inside.
+ *        Boxes near the frustum edges can be reported as intersecting even
+ *        though they are outside, which is fine for culling and selection.
+ */
+math::Containment math::classify_frustum_aabb(const Frustum &frustum,
+                                              const AABB &aabb) {
+    Containment result = Containment::kInside;
+    for (const glm::vec4 &plane : frustum.planes) {
+        glm::vec3 normal = glm::vec3(plane);
+        glm::vec3 positive{normal.x >= 0.f ? aabb.max.x : aabb.min.x,
+                           normal.y >= 0.f ? aabb.max.y : aabb.min.y,
+                           normal.z >= 0.f ? aabb.max.z : aabb.min.z};
+        if (glm::dot(normal, positive) + plane.w < 0.f) {
+            return Containment::kOutside;
+        }
+
+        glm::vec3 negative{normal.x >= 0.f ? aabb.min.x : aabb.max.x,
+                           normal.y >= 0.f ? aabb.min.y : aabb.max.y,
+                           normal.z >= 0.f ? aabb.min.z : aabb.max.z};
+        if (glm::dot(normal, negative) + plane.w < 0.f) {
+            result = Containment::kIntersecting;
+        }
+    }
+    return result;
+}
+
+bool math::intersect_frustum_aabb(const Frustum &frustum, const AABB &aabb) {
+    return classify_frustum_aabb(frustum, aabb) != Containment::kOutside;
+}
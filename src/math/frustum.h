@@ -0,0 +1,29 @@
+#pragma once
+#include "aabb.h"
+#include <array>
+#include <glm/glm.hpp>
+
+namespace math {
+/// Convex volume bounded by six planes. Each plane is stored as (normal, d)
+/// with the normal pointing inwards, so a point p is inside the plane when
+/// dot(normal, p) + d >= 0.
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+};
+
+enum class Containment {
+    kOutside,
+    kIntersecting,
+    kInside,
+};
+
+/// Builds the frustum spanned by the four corners of its near face and the
+/// matching four corners of its far face, both given in the same winding
+Frustum frustum_from_corners(const std::array<glm::vec3, 4> &nearCorners,
+                             const std::array<glm::vec3, 4> &farCorners);
+/// Extracts the planes of a view projection matrix with depth in [0, 1]
+/// (Gribb and Hartmann)
+Frustum frustum_from_matrix(const glm::mat4 &viewproj);
+Containment classify_frustum_aabb(const Frustum &frustum, const AABB &aabb);
+bool intersect_frustum_aabb(const Frustum &frustum, const AABB &aabb);
+} // namespace math
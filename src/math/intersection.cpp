@@ -82,6 +82,35 @@ bool math::intersect_ray_aabb(const Ray &ray, const math::AABB &aabb) {
     return intersect_ray_aabb(ray, aabb, dummyDistance);
 }
 
+math::RayPacket::RayPacket(const Ray &ray) : origin(ray.origin) {
+    // NOTE: Axes the ray is parallel to get a huge but finite reciprocal.
+    // Infinity would turn into NaN for origins on a slab plane (0 * inf),
+    // and -ffast-math assumes there are no NaNs.
+    constexpr float kMinDirection = 1e-20f;
+    for (int i = 0; i < 3; i++) {
+        float direction = ray.direction[i];
+        if (std::abs(direction) < kMinDirection) {
+            direction = direction < 0.f ? -kMinDirection : kMinDirection;
+        }
+        invDirection[i] = 1.f / direction;
+    }
+}
+
+bool math::intersect_ray_aabb(const RayPacket &ray, const math::AABB &aabb,
+                              float maxDistance,
+                              float &outIntersectionDistance) {
+    glm::vec3 t1 = (aabb.min - ray.origin) * ray.invDirection;
+    glm::vec3 t2 = (aabb.max - ray.origin) * ray.invDirection;
+    glm::vec3 tMin = glm::min(t1, t2);
+    glm::vec3 tMax = glm::max(t1, t2);
+
+    float tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+    float tFar =
+        std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+    outIntersectionDistance = tNear;
+    return tNear <= tFar;
+}
+
 glm::vec3 math::intersect_ray_plane(const Ray &ray,
                                     const glm::vec3 &planeOrigin,
                                     const glm::vec3 &planeNormal) {
@@ -8,9 +8,22 @@ struct Ray {
 };
 
 namespace math {
+/// A ray with its reciprocal direction computed once, so slab tests against
+/// many boxes multiply instead of divide and need no parallel special case
+struct RayPacket {
+    glm::vec3 origin;
+    glm::vec3 invDirection;
+
+    explicit RayPacket(const Ray &ray);
+};
+
 bool intersect_ray_aabb(const Ray &ray, const math::AABB &aabb,
                         float &outIntersectionDistance);
 bool intersect_ray_aabb(const Ray &ray, const math::AABB &aabb);
+/// Branchless slab test. Only hits closer than maxDistance count, and the
+/// distance is clamped to 0 when the origin is inside the box.
+bool intersect_ray_aabb(const RayPacket &ray, const math::AABB &aabb,
+                        float maxDistance, float &outIntersectionDistance);
 glm::vec3 intersect_ray_plane(const Ray &ray, const glm::vec3 &planeOrigin,
                               const glm::vec3 &planeNormal);
 } // namespace math
@@ -1,5 +1,6 @@
 #include "transform.h"
 
+#include <cmath>
 #include <glm/gtx/matrix_decompose.hpp>
 
 namespace {
@@ -28,14 +29,40 @@ Transform Transform::operator*(const Transform &rhs) const {
     if (rhs.is_identity()) {
         return *this;
     }
-    return Transform(as_matrix() * rhs.as_matrix());
+
+    // NOTE: T1 R1 S1 T2 R2 S2 only splits back into translation, rotation
+    // and scale if S1 commutes with R2
+    bool rhsHasRotation = rhs._heading != glm::identity<glm::quat>();
+    if (rhsHasRotation && !has_uniform_scale()) {
+        return Transform(as_matrix() * rhs.as_matrix());
+    }
+
+    Transform result;
+    result._position = _position + _heading * (_scale * rhs._position);
+    result._heading = glm::normalize(_heading * rhs._heading);
+    result._scale = _scale * rhs._scale;
+    result._isDirty = true;
+    return result;
 }
 
 Transform Transform::inverse() const {
     if (is_identity()) {
         return Transform{};
     }
-    return Transform(glm::inverse(as_matrix()));
+
+    // NOTE: (T R S)^-1 = S^-1 R^-1 T^-1, which is only a TRS again if S^-1
+    // commutes with R^-1
+    bool hasRotation = _heading != glm::identity<glm::quat>();
+    if (hasRotation && !has_uniform_scale()) {
+        return Transform(glm::inverse(as_matrix()));
+    }
+
+    Transform result;
+    result._heading = glm::conjugate(_heading);
+    result._scale = 1.f / _scale;
+    result._position = result._scale * (result._heading * -_position);
+    result._isDirty = true;
+    return result;
 }
 
 const glm::mat4 &Transform::as_matrix() const {
@@ -68,4 +95,14 @@ void Transform::scale(const glm::vec3 &s) {
     _isDirty = true;
 }
 
-bool Transform::is_identity() const { return as_matrix() == I; }
+bool Transform::is_identity() const {
+    return _position == glm::vec3(0.f) &&
+           _heading == glm::identity<glm::quat>() && _scale == glm::vec3(1.f);
+}
+
+bool Transform::has_uniform_scale() const {
+    // NOTE: Relative, so scales that only differ by float noise still count
+    float tolerance = 1e-5f * std::abs(_scale.x);
+    return std::abs(_scale.x - _scale.y) <= tolerance &&
+           std::abs(_scale.x - _scale.z) <= tolerance;
+}
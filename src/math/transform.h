@@ -18,7 +18,12 @@ class Transform {
 
     const glm::mat4 &as_matrix() const;
 
+    /// Composes position, heading and scale directly. Only falls back to
+    /// multiplying and decomposing matrices when non-uniform scale meets a
+    /// rotation, where the result may be sheared.
     Transform operator*(const Transform &rhs) const;
+    /// Inverts analytically for uniform scale or no rotation, otherwise
+    /// through the inverse matrix
     Transform inverse() const;
 
     glm::vec3 get_local_up() const { return _heading * math::GLOBAL_UP_AXIS; }
@@ -30,6 +35,7 @@ class Transform {
     }
 
     bool is_identity() const;
+    bool has_uniform_scale() const;
 
     void position(const glm::vec3 &pos);
     void heading(const glm::quat &h);
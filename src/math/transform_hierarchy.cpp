@@ -0,0 +1,363 @@
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <immintrin.h>
+
+uint32_t TransformHierarchy::index_of(Handle handle) const {
+    assert(handle < _indices.size() && _handles[_indices[handle]] == handle);
+    return _indices[handle];
+}
+
+TransformHierarchy::Handle TransformHierarchy::parent(Handle handle) const {
+    return _parents[index_of(handle)];
+}
+
+uint32_t TransformHierarchy::user_data(Handle handle) const {
+    return _userData[index_of(handle)];
+}
+
+glm::vec3 TransformHierarchy::local_position(Handle handle) const {
+    uint32_t index = index_of(handle);
+    return glm::vec3(_positionX[index], _positionY[index], _positionZ[index]);
+}
+
+const glm::mat4 &TransformHierarchy::world_matrix(Handle handle) const {
+    return _worldMatrices[index_of(handle)];
+}
+
+bool TransformHierarchy::is_dirty(Handle handle) const {
+    uint32_t index = index_of(handle);
+    return (_dirty[index / 64] >> (index % 64)) & 1;
+}
+
+void TransformHierarchy::write_local(uint32_t index, const glm::vec3 &position,
+                                     const glm::quat &heading,
+                                     const glm::vec3 &scale) {
+    _positionX[index] = position.x;
+    _positionY[index] = position.y;
+    _positionZ[index] = position.z;
+    _headingX[index] = heading.x;
+    _headingY[index] = heading.y;
+    _headingZ[index] = heading.z;
+    _headingW[index] = heading.w;
+    _scaleX[index] = scale.x;
+    _scaleY[index] = scale.y;
+    _scaleZ[index] = scale.z;
+}
+
+TransformHierarchy::Handle TransformHierarchy::create(const Transform &local,
+                                                      uint32_t userData,
+                                                      Handle parent) {
+    Handle handle;
+    if (_freeHandles.empty()) {
+        handle = (Handle)_indices.size();
+        _indices.push_back(0);
+    } else {
+        handle = _freeHandles.back();
+        _freeHandles.pop_back();
+    }
+
+    uint32_t index = (uint32_t)_handles.size();
+    _indices[handle] = index;
+    _handles.push_back(handle);
+    _userData.push_back(userData);
+    _parents.push_back(parent);
+    _firstChildren.push_back(kNullHandle);
+    _nextSiblings.push_back(kNullHandle);
+
+    size_t count = _handles.size();
+    _positionX.resize(count);
+    _positionY.resize(count);
+    _positionZ.resize(count);
+    _headingX.resize(count);
+    _headingY.resize(count);
+    _headingZ.resize(count);
+    _headingW.resize(count);
+    _scaleX.resize(count);
+    _scaleY.resize(count);
+    _scaleZ.resize(count);
+    _dirty.resize((count + 63) / 64, 0);
+    write_local(index, local.position(), local.heading(), local.scale());
+
+    // NOTE: The world matrix is valid right away, so a node created after
+    // the last update can be drawn before the next one
+    glm::mat4 world = local.as_matrix();
+    if (parent != kNullHandle) {
+        uint32_t parentIndex = index_of(parent);
+        world = _worldMatrices[parentIndex] * world;
+        _nextSiblings[index] = _firstChildren[parentIndex];
+        _firstChildren[parentIndex] = handle;
+    }
+    _worldMatrices.push_back(world);
+
+    mark_dirty(index);
+    return handle;
+}
+
+void TransformHierarchy::destroy(Handle handle) {
+    uint32_t index = index_of(handle);
+
+    Handle parent = _parents[index];
+    if (parent != kNullHandle) {
+        Handle *link = &_firstChildren[index_of(parent)];
+        while (*link != handle) {
+            link = &_nextSiblings[index_of(*link)];
+        }
+        *link = _nextSiblings[index];
+    }
+
+    Handle child = _firstChildren[index];
+    while (child != kNullHandle) {
+        uint32_t childIndex = index_of(child);
+        child = _nextSiblings[childIndex];
+        _parents[childIndex] = kNullHandle;
+        _nextSiblings[childIndex] = kNullHandle;
+        mark_dirty(childIndex);
+    }
+
+    // NOTE: The slot stays in place until the next update so the order of
+    // everything else is untouched
+    _handles[index] = kNullHandle;
+    _dirty[index / 64] &= ~(1ull << (index % 64));
+    _freeHandles.push_back(handle);
+    _destroyedCount++;
+}
+
+void TransformHierarchy::clear() {
+    _positionX.clear();
+    _positionY.clear();
+    _positionZ.clear();
+    _headingX.clear();
+    _headingY.clear();
+    _headingZ.clear();
+    _headingW.clear();
+    _scaleX.clear();
+    _scaleY.clear();
+    _scaleZ.clear();
+    _worldMatrices.clear();
+    _userData.clear();
+    _handles.clear();
+    _parents.clear();
+    _firstChildren.clear();
+    _nextSiblings.clear();
+    _dirty.clear();
+    _indices.clear();
+    _freeHandles.clear();
+    _destroyedCount = 0;
+}
+
+void TransformHierarchy::set_local(Handle handle, const Transform &local) {
+    uint32_t index = index_of(handle);
+    write_local(index, local.position(), local.heading(), local.scale());
+    mark_dirty(index);
+}
+
+void TransformHierarchy::set_local_position(Handle handle,
+                                            const glm::vec3 &position) {
+    uint32_t index = index_of(handle);
+    _positionX[index] = position.x;
+    _positionY[index] = position.y;
+    _positionZ[index] = position.z;
+    mark_dirty(index);
+}
+
+void TransformHierarchy::mark_dirty(uint32_t index) {
+    uint64_t bit = 1ull << (index % 64);
+    // NOTE: A dirty node always has dirty descendants, so there is nothing
+    // left to do below it
+    if (_dirty[index / 64] & bit) {
+        return;
+    }
+    _dirty[index / 64] |= bit;
+
+    for (Handle child = _firstChildren[index]; child != kNullHandle;
+         child = _nextSiblings[_indices[child]]) {
+        mark_dirty(_indices[child]);
+    }
+}
+
+/**
+ * @brief Closes the gaps left by destroyed nodes. Live nodes only ever move
+ *        towards the front and keep their relative order, so parents still
+ *        come before their children.
+ */
+void TransformHierarchy::compact() {
+    uint32_t count = (uint32_t)_handles.size();
+    uint32_t write = 0;
+    for (uint32_t read = 0; read < count; read++) {
+        Handle handle = _handles[read];
+        if (handle == kNullHandle) {
+            continue;
+        }
+        if (write != read) {
+            _positionX[write] = _positionX[read];
+            _positionY[write] = _positionY[read];
+            _positionZ[write] = _positionZ[read];
+            _headingX[write] = _headingX[read];
+            _headingY[write] = _headingY[read];
+            _headingZ[write] = _headingZ[read];
+            _headingW[write] = _headingW[read];
+            _scaleX[write] = _scaleX[read];
+            _scaleY[write] = _scaleY[read];
+            _scaleZ[write] = _scaleZ[read];
+            _worldMatrices[write] = _worldMatrices[read];
+            _userData[write] = _userData[read];
+            _handles[write] = handle;
+            _parents[write] = _parents[read];
+            _firstChildren[write] = _firstChildren[read];
+            _nextSiblings[write] = _nextSiblings[read];
+
+            uint64_t dirty = (_dirty[read / 64] >> (read % 64)) & 1;
+            _dirty[write / 64] &= ~(1ull << (write % 64));
+            _dirty[write / 64] |= dirty << (write % 64);
+            _indices[handle] = write;
+        }
+        write++;
+    }
+
+    _positionX.resize(write);
+    _positionY.resize(write);
+    _positionZ.resize(write);
+    _headingX.resize(write);
+    _headingY.resize(write);
+    _headingZ.resize(write);
+    _headingW.resize(write);
+    _scaleX.resize(write);
+    _scaleY.resize(write);
+    _scaleZ.resize(write);
+    _worldMatrices.resize(write);
+    _userData.resize(write);
+    _handles.resize(write);
+    _parents.resize(write);
+    _firstChildren.resize(write);
+    _nextSiblings.resize(write);
+    _dirty.resize((write + 63) / 64);
+    if (write % 64 != 0) {
+        _dirty.back() &= (1ull << (write % 64)) - 1;
+    }
+    _destroyedCount = 0;
+}
+
+/**
+ * @brief Builds translation * rotation * scale for the dirty nodes, 4 at a
+ *        time with SSE. The components of 4 nodes are gathered into one
+ *        register each, and the resulting columns are transposed back into
+ *        one matrix per node.
+ */
+void TransformHierarchy::compute_local_matrices() {
+    const uint32_t *indices = _dirtyIndices.data();
+    uint32_t count = (uint32_t)_dirtyIndices.size();
+    __m128 one = _mm_set1_ps(1.f);
+
+    for (uint32_t i = 0; i < count; i += 4) {
+        // NOTE: The last batch repeats its last node to fill the register,
+        // which just writes the same matrix twice
+        uint32_t lanes[4];
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            lanes[lane] = indices[std::min(i + lane, count - 1)];
+        }
+
+        auto gather = [&lanes](const std::vector<float> &values) {
+            return _mm_setr_ps(values[lanes[0]], values[lanes[1]],
+                               values[lanes[2]], values[lanes[3]]);
+        };
+        __m128 x = gather(_headingX);
+        __m128 y = gather(_headingY);
+        __m128 z = gather(_headingZ);
+        __m128 w = gather(_headingW);
+
+        __m128 x2 = _mm_add_ps(x, x);
+        __m128 y2 = _mm_add_ps(y, y);
+        __m128 z2 = _mm_add_ps(z, z);
+        __m128 xx = _mm_mul_ps(x, x2);
+        __m128 yy = _mm_mul_ps(y, y2);
+        __m128 zz = _mm_mul_ps(z, z2);
+        __m128 xy = _mm_mul_ps(x, y2);
+        __m128 xz = _mm_mul_ps(x, z2);
+        __m128 yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2);
+        __m128 wy = _mm_mul_ps(w, y2);
+        __m128 wz = _mm_mul_ps(w, z2);
+
+        __m128 scaleX = gather(_scaleX);
+        __m128 scaleY = gather(_scaleY);
+        __m128 scaleZ = gather(_scaleZ);
+
+        // NOTE: columns[c][r] holds row r of column c for all 4 nodes
+        __m128 columns[4][4];
+        columns[0][0] =
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scaleX);
+        columns[0][1] = _mm_mul_ps(_mm_add_ps(xy, wz), scaleX);
+        columns[0][2] = _mm_mul_ps(_mm_sub_ps(xz, wy), scaleX);
+        columns[0][3] = _mm_setzero_ps();
+        columns[1][0] = _mm_mul_ps(_mm_sub_ps(xy, wz), scaleY);
+        columns[1][1] =
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scaleY);
+        columns[1][2] = _mm_mul_ps(_mm_add_ps(yz, wx), scaleY);
+        columns[1][3] = _mm_setzero_ps();
+        columns[2][0] = _mm_mul_ps(_mm_add_ps(xz, wy), scaleZ);
+        columns[2][1] = _mm_mul_ps(_mm_sub_ps(yz, wx), scaleZ);
+        columns[2][2] =
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scaleZ);
+        columns[2][3] = _mm_setzero_ps();
+        columns[3][0] = gather(_positionX);
+        columns[3][1] = gather(_positionY);
+        columns[3][2] = gather(_positionZ);
+        columns[3][3] = one;
+
+        for (int c = 0; c < 4; c++) {
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2],
+                              columns[c][3]);
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                _mm_storeu_ps(&_worldMatrices[lanes[lane]][c][0],
+                              columns[c][lane]);
+            }
+        }
+    }
+}
+
+static inline void multiply_matrices(const glm::mat4 &a, glm::mat4 &b) {
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for (int c = 0; c < 4; c++) {
+        __m128 column = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[c][0])),
+                       _mm_mul_ps(a1, _mm_set1_ps(b[c][1]))),
+            _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[c][2])),
+                       _mm_mul_ps(a3, _mm_set1_ps(b[c][3]))));
+        _mm_storeu_ps(&b[c][0], column);
+    }
+}
+
+void TransformHierarchy::update(std::vector<Handle> &outChanged) {
+    if (_destroyedCount > 0) {
+        compact();
+    }
+
+    _dirtyIndices.clear();
+    for (uint32_t word = 0; word < _dirty.size(); word++) {
+        for (uint64_t bits = _dirty[word]; bits; bits &= bits - 1) {
+            _dirtyIndices.push_back(word * 64 +
+                                    (uint32_t)std::countr_zero(bits));
+        }
+        _dirty[word] = 0;
+    }
+    if (_dirtyIndices.empty()) {
+        return;
+    }
+
+    compute_local_matrices();
+
+    // NOTE: Indices are ascending, so a parent is final before any of its
+    // children reads it
+    for (uint32_t index : _dirtyIndices) {
+        if (_parents[index] != kNullHandle) {
+            multiply_matrices(_worldMatrices[_indices[_parents[index]]],
+                              _worldMatrices[index]);
+        }
+        outChanged.push_back(_handles[index]);
+    }
+}
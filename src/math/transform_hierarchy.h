@@ -0,0 +1,75 @@
+#pragma once
+#include "transform.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+/// Local position, heading and scale of every node with one array per
+/// component, and the world matrices built from them. Nodes are kept in
+/// topological order, parents always before their children, so world
+/// matrices can be rebuilt in a single forward pass. Marking a node dirty
+/// also marks its descendants, and only dirty nodes are rebuilt.
+class TransformHierarchy {
+  public:
+    using Handle = uint32_t;
+    static constexpr Handle kNullHandle = UINT32_MAX;
+
+    /// The parent has to exist already, which keeps the order topological
+    Handle create(const Transform &local, uint32_t userData,
+                  Handle parent = kNullHandle);
+    /// Children of the node become roots and keep their local transform
+    void destroy(Handle handle);
+    void clear();
+
+    void set_local(Handle handle, const Transform &local);
+    void set_local_position(Handle handle, const glm::vec3 &position);
+
+    Handle parent(Handle handle) const;
+    uint32_t user_data(Handle handle) const;
+    glm::vec3 local_position(Handle handle) const;
+    /// Only up to date after update() if the node was dirty
+    const glm::mat4 &world_matrix(Handle handle) const;
+    bool is_dirty(Handle handle) const;
+    size_t size() const { return _handles.size() - _destroyedCount; }
+
+    /// Rebuilds the world matrix of every dirty node and appends the handles
+    /// of those nodes, parents before children
+    void update(std::vector<Handle> &outChanged);
+
+  private:
+    // NOTE: Indexed by dense index
+    std::vector<float> _positionX;
+    std::vector<float> _positionY;
+    std::vector<float> _positionZ;
+    std::vector<float> _headingX;
+    std::vector<float> _headingY;
+    std::vector<float> _headingZ;
+    std::vector<float> _headingW;
+    std::vector<float> _scaleX;
+    std::vector<float> _scaleY;
+    std::vector<float> _scaleZ;
+    std::vector<glm::mat4> _worldMatrices;
+    std::vector<uint32_t> _userData;
+    std::vector<Handle> _handles;
+    // NOTE: Links between nodes are handles so compaction does not have to
+    // rewrite them
+    std::vector<Handle> _parents;
+    std::vector<Handle> _firstChildren;
+    std::vector<Handle> _nextSiblings;
+    std::vector<uint64_t> _dirty;
+
+    // NOTE: Indexed by handle
+    std::vector<uint32_t> _indices;
+    std::vector<Handle> _freeHandles;
+
+    uint32_t _destroyedCount{0};
+    std::vector<uint32_t> _dirtyIndices;
+
+    uint32_t index_of(Handle handle) const;
+    void mark_dirty(uint32_t index);
+    void compact();
+    void compute_local_matrices();
+    void write_local(uint32_t index, const glm::vec3 &position,
+                     const glm::quat &heading, const glm::vec3 &scale);
+};
@@ -0,0 +1,210 @@
+#include "movement.h"
+#include "cpu.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+// NOTE: Keeps the divisions finite for movers sitting on their target, whose
+// result is thrown away anyway
+static constexpr float kMinDistanceSquared = 1e-12f;
+
+void MoverArrays::clear() {
+    entities.clear();
+    agentIndices.clear();
+    positionX.clear();
+    positionZ.clear();
+    targetX.clear();
+    targetZ.clear();
+    maxSpeeds.clear();
+    velocityX.clear();
+    velocityZ.clear();
+    hasArrived.clear();
+}
+
+void MoverArrays::add(entt::entity entity, uint32_t agentIndex,
+                      const glm::vec2 &position, const glm::vec2 &target,
+                      float maxSpeed) {
+    entities.push_back(entity);
+    agentIndices.push_back(agentIndex);
+    positionX.push_back(position.x);
+    positionZ.push_back(position.y);
+    targetX.push_back(target.x);
+    targetZ.push_back(target.y);
+    maxSpeeds.push_back(maxSpeed);
+}
+
+SIMD_TARGET_AVX2 static size_t steer_movers_avx2(MoverArrays &movers,
+                                                 float arriveDistance,
+                                                 float dt) {
+    size_t count = movers.size();
+    __m256 arriveSquared = _mm256_set1_ps(arriveDistance * arriveDistance);
+    __m256 invDt = _mm256_set1_ps(1.f / dt);
+    __m256 minDistanceSquared = _mm256_set1_ps(kMinDistanceSquared);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&movers.targetX[i]),
+                                  _mm256_loadu_ps(&movers.positionX[i]));
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&movers.targetZ[i]),
+                                  _mm256_loadu_ps(&movers.positionZ[i]));
+        __m256 distanceSquared =
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dz, dz));
+        __m256 distance = _mm256_sqrt_ps(
+            _mm256_max_ps(distanceSquared, minDistanceSquared));
+
+        __m256 speed = _mm256_min_ps(_mm256_loadu_ps(&movers.maxSpeeds[i]),
+                                     _mm256_mul_ps(distance, invDt));
+        __m256 arrived =
+            _mm256_cmp_ps(distanceSquared, arriveSquared, _CMP_LE_OQ);
+        __m256 scale =
+            _mm256_andnot_ps(arrived, _mm256_div_ps(speed, distance));
+        _mm256_storeu_ps(&movers.velocityX[i], _mm256_mul_ps(dx, scale));
+        _mm256_storeu_ps(&movers.velocityZ[i], _mm256_mul_ps(dz, scale));
+
+        int mask = _mm256_movemask_ps(arrived);
+        for (int lane = 0; lane < 8; lane++) {
+            movers.hasArrived[i + lane] = (uint8_t)((mask >> lane) & 1);
+        }
+    }
+    return i;
+}
+
+void steer_movers(MoverArrays &movers, float arriveDistance, float dt) {
+    size_t count = movers.size();
+    movers.velocityX.resize(count);
+    movers.velocityZ.resize(count);
+    movers.hasArrived.resize(count);
+
+    size_t i = 0;
+    if (simd_level() >= SimdLevel::kAVX2) {
+        i = steer_movers_avx2(movers, arriveDistance, dt);
+    }
+
+    __m128 arriveSquared = _mm_set1_ps(arriveDistance * arriveDistance);
+    __m128 invDt = _mm_set1_ps(1.f / dt);
+    __m128 minDistanceSquared = _mm_set1_ps(kMinDistanceSquared);
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&movers.targetX[i]),
+                               _mm_loadu_ps(&movers.positionX[i]));
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&movers.targetZ[i]),
+                               _mm_loadu_ps(&movers.positionZ[i]));
+        __m128 distanceSquared =
+            _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+        __m128 distance =
+            _mm_sqrt_ps(_mm_max_ps(distanceSquared, minDistanceSquared));
+
+        __m128 speed = _mm_min_ps(_mm_loadu_ps(&movers.maxSpeeds[i]),
+                                  _mm_mul_ps(distance, invDt));
+        __m128 arrived = _mm_cmple_ps(distanceSquared, arriveSquared);
+        __m128 scale = _mm_andnot_ps(arrived, _mm_div_ps(speed, distance));
+        _mm_storeu_ps(&movers.velocityX[i], _mm_mul_ps(dx, scale));
+        _mm_storeu_ps(&movers.velocityZ[i], _mm_mul_ps(dz, scale));
+
+        int mask = _mm_movemask_ps(arrived);
+        for (int lane = 0; lane < 4; lane++) {
+            movers.hasArrived[i + lane] = (uint8_t)((mask >> lane) & 1);
+        }
+    }
+
+    for (; i < count; i++) {
+        float dx = movers.targetX[i] - movers.positionX[i];
+        float dz = movers.targetZ[i] - movers.positionZ[i];
+        float distanceSquared = dx * dx + dz * dz;
+        if (distanceSquared <= arriveDistance * arriveDistance) {
+            movers.velocityX[i] = 0.f;
+            movers.velocityZ[i] = 0.f;
+            movers.hasArrived[i] = 1;
+            continue;
+        }
+
+        float distance = sqrtf(distanceSquared);
+        float speed = std::min(movers.maxSpeeds[i], distance / dt);
+        movers.velocityX[i] = dx / distance * speed;
+        movers.velocityZ[i] = dz / distance * speed;
+        movers.hasArrived[i] = 0;
+    }
+}
+
+void HeadingArrays::resize(size_t count) {
+    w.resize(count);
+    y.resize(count);
+}
+
+// NOTE: quatLookAt turns -z towards the direction d. That is a rotation about
+// the up axis by an angle a with sin(a) = -d.x and cos(a) = -d.z, and the
+// quaternion of half that angle is (1 + cos(a), sin(a)) normalized. Scaling by
+// the speed s instead of normalizing d first gives (s - v.z, -v.x). Facing
+// straight along +z leaves nothing to normalize, that is the half turn
+// (0, 1).
+SIMD_TARGET_AVX2 static size_t
+compute_headings_avx2(std::span<const glm::vec2> velocities,
+                      HeadingArrays &out) {
+    size_t count = velocities.size();
+    const float *v = (const float *)velocities.data();
+    __m256 minLengthSquared = _mm256_set1_ps(kMinDistanceSquared);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // NOTE: Splits x0 z0 x1 z1 ... into the x and z of 8 velocities,
+        // the shuffle works within 128 bit lanes so the permute restores
+        // the order
+        __m256 lo = _mm256_loadu_ps(v + 2 * i);
+        __m256 hi = _mm256_loadu_ps(v + 2 * i + 8);
+        __m256 evens = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 odds = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 vx = _mm256_castpd_ps(_mm256_permute4x64_pd(
+            _mm256_castps_pd(evens), _MM_SHUFFLE(3, 1, 2, 0)));
+        __m256 vz = _mm256_castpd_ps(_mm256_permute4x64_pd(
+            _mm256_castps_pd(odds), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        __m256 speed = _mm256_sqrt_ps(
+            _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vz, vz)));
+        __m256 a = _mm256_sub_ps(speed, vz);
+        __m256 b = _mm256_sub_ps(_mm256_setzero_ps(), vx);
+        __m256 lengthSquared =
+            _mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        __m256 isHalfTurn = _mm256_cmp_ps(
+            lengthSquared,
+            _mm256_mul_ps(minLengthSquared, _mm256_mul_ps(speed, speed)),
+            _CMP_LE_OQ);
+        __m256 invLength = _mm256_div_ps(
+            _mm256_set1_ps(1.f),
+            _mm256_sqrt_ps(_mm256_max_ps(lengthSquared, minLengthSquared)));
+
+        _mm256_storeu_ps(&out.w[i],
+                         _mm256_andnot_ps(isHalfTurn,
+                                          _mm256_mul_ps(a, invLength)));
+        _mm256_storeu_ps(&out.y[i],
+                         _mm256_blendv_ps(_mm256_mul_ps(b, invLength),
+                                          _mm256_set1_ps(1.f), isHalfTurn));
+    }
+    return i;
+}
+
+void compute_headings(std::span<const glm::vec2> velocities,
+                      HeadingArrays &out) {
+    size_t count = velocities.size();
+    out.resize(count);
+
+    size_t i = 0;
+    if (simd_level() >= SimdLevel::kAVX2) {
+        i = compute_headings_avx2(velocities, out);
+    }
+
+    for (; i < count; i++) {
+        glm::vec2 velocity = velocities[i];
+        float speed = glm::length(velocity);
+        float a = speed - velocity.y;
+        float b = -velocity.x;
+        float lengthSquared = a * a + b * b;
+        if (lengthSquared <= kMinDistanceSquared * speed * speed) {
+            out.w[i] = 0.f;
+            out.y[i] = 1.f;
+            continue;
+        }
+
+        float invLength = 1.f / sqrtf(lengthSquared);
+        out.w[i] = a * invLength;
+        out.y[i] = b * invLength;
+    }
+}
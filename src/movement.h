@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <span>
+#include <vector>
+
+/// Units with a move order, one array per field so a SIMD register holds the
+/// same field of several movers. Coordinates are on the ground plane, x being
+/// world x and z world z.
+struct MoverArrays {
+    std::vector<entt::entity> entities;
+    /// Index of the mover in AvoidanceAgents
+    std::vector<uint32_t> agentIndices;
+    std::vector<float> positionX;
+    std::vector<float> positionZ;
+    std::vector<float> targetX;
+    std::vector<float> targetZ;
+    std::vector<float> maxSpeeds;
+    /// Outputs of steer_movers
+    std::vector<float> velocityX;
+    std::vector<float> velocityZ;
+    std::vector<uint8_t> hasArrived;
+
+    void clear();
+    void add(entt::entity entity, uint32_t agentIndex,
+             const glm::vec2 &position, const glm::vec2 &target,
+             float maxSpeed);
+    size_t size() const { return entities.size(); }
+};
+
+/// Picks the velocity that heads straight for the target at up to the max
+/// speed, slowing down to land on it instead of overshooting within dt.
+/// Movers closer than arriveDistance get no velocity and are flagged as
+/// arrived. 8 movers at a time with AVX2 or 4 with SSE.
+void steer_movers(MoverArrays &movers, float arriveDistance, float dt);
+
+/// Rotations about the up axis, where w and y are the only parts of the
+/// quaternion that are not zero
+struct HeadingArrays {
+    std::vector<float> w;
+    std::vector<float> y;
+
+    size_t size() const { return w.size(); }
+    void resize(size_t count);
+    glm::quat get(size_t index) const {
+        return glm::quat(w[index], 0.f, y[index], 0.f);
+    }
+};
+
+/// The heading facing along each velocity, the same rotation quatLookAt
+/// gives for a direction on the ground plane but without normalizing or
+/// building a matrix first. A zero velocity has no direction and gets the
+/// half turn about the up axis that a velocity along +z gets, so callers
+/// keep the old heading of units standing still.
+void compute_headings(std::span<const glm::vec2> velocities,
+                      HeadingArrays &out);
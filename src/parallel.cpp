@@ -0,0 +1,253 @@
+#include "parallel.h"
+#include <algorithm>
+#include <cassert>
+
+// NOTE: Index of the calling thread in JobSystem::_threads
+static thread_local uint32_t currentThread = UINT32_MAX;
+
+// NOTE: Ordered atomics instead of standalone fences. The bottom store in
+// pop and the top load after it must not be reordered, which is what makes
+// the owner and a thief agree on who gets the last job.
+bool JobDeque::push(Job *job) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top >= kCapacity) {
+        return false;
+    }
+
+    _buffer[bottom & kMask].store(job, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+Job *JobDeque::pop() {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_seq_cst);
+
+    if (top > bottom) {
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = _buffer[bottom & kMask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // NOTE: Last job left, race the thieves for it
+        if (!_top.compare_exchange_strong(top, top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job *JobDeque::steal() {
+    int64_t top = _top.load(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_seq_cst);
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    Job *job = _buffer[top & kMask].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+void JobSystem::init(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    // NOTE: Leave room for a few threads that register later
+    threadCount = std::min(threadCount, kMaxThreads - 4);
+
+    _isRunning = true;
+    register_thread();
+    _workers.reserve(threadCount - 1);
+    for (uint32_t i = 0; i + 1 < threadCount; i++) {
+        _workers.emplace_back(&JobSystem::worker_loop, this);
+    }
+}
+
+void JobSystem::deinit() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _isRunning = false;
+    }
+    _wakeCondition.notify_all();
+    for (std::thread &worker : _workers) {
+        worker.join();
+    }
+    _workers.clear();
+
+    for (std::unique_ptr<ThreadState> &state : _threads) {
+        state.reset();
+    }
+    _threadCount = 0;
+    _queuedJobs = 0;
+    currentThread = UINT32_MAX;
+}
+
+void JobSystem::register_thread() {
+    assert(currentThread == UINT32_MAX);
+
+    // NOTE: Thieves only look at threads below _threadCount, so the state has
+    // to be in place before the count goes up
+    std::lock_guard<std::mutex> lock(_registerMutex);
+    uint32_t index = _threadCount.load(std::memory_order_relaxed);
+    assert(index < kMaxThreads);
+    _threads[index] = std::make_unique<ThreadState>();
+    _threads[index]->jobs = std::make_unique<Job[]>(kJobsPerThread);
+    _threadCount.store(index + 1, std::memory_order_release);
+    currentThread = index;
+}
+
+uint32_t JobSystem::current_thread() {
+    assert(currentThread != UINT32_MAX &&
+           "jobs can only be used from registered threads");
+    return currentThread;
+}
+
+Job *JobSystem::allocate_job(const char *name, JobCounter &counter) {
+    ThreadState &state = *_threads[current_thread()];
+    Job *job = &state.jobs[state.nextJob & (kJobsPerThread - 1)];
+    // NOTE: Pairs with the release once the job has run, so whoever ran it
+    // is done with the slot
+    if (job->isLive.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    state.nextJob++;
+    job->isLive.store(true, std::memory_order_relaxed);
+    job->counter = &counter;
+    job->name = name;
+    counter._pending.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::submit(Job *job) {
+    uint32_t thread = current_thread();
+    if (!_threads[thread]->deque.push(job)) {
+        execute(job, thread);
+        return;
+    }
+
+    // NOTE: Pairs with the sleeping count going up before a worker checks
+    // for queued jobs, so either it sees the job or we see it sleeping
+    _queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+    if (_sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+        }
+        _wakeCondition.notify_one();
+    }
+}
+
+void JobSystem::submit_after(JobCounter &dependency, Job *job) {
+    {
+        std::lock_guard<std::mutex> lock(dependency._mutex);
+        if (!dependency.is_done()) {
+            dependency._continuations.push_back(job);
+            return;
+        }
+    }
+    submit(job);
+}
+
+Job *JobSystem::find_job(uint32_t thread) {
+    Job *job = _threads[thread]->deque.pop();
+    if (!job) {
+        uint32_t threadCount = _threadCount.load(std::memory_order_acquire);
+        for (uint32_t i = 1; i < threadCount && !job; i++) {
+            job = _threads[(thread + i) % threadCount]->deque.steal();
+        }
+    }
+
+    if (job) {
+        _queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void JobSystem::execute(Job *job, uint32_t thread) {
+    JobCounter *counter = job->counter;
+    const char *name = job->name;
+
+    if (_isProfiling.load(std::memory_order_relaxed)) {
+        auto start = std::chrono::steady_clock::now();
+        job->fn(job);
+        _threads[thread]->samples.push_back(
+            JobSample{name, thread, start, std::chrono::steady_clock::now()});
+    } else {
+        job->fn(job);
+    }
+    job->isLive.store(false, std::memory_order_release);
+
+    // NOTE: The decrement happens under the lock so wait() can lock it to
+    // make sure nobody touches the counter anymore before it goes away
+    std::vector<Job *> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->_mutex);
+        if (counter->_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready.swap(counter->_continuations);
+        }
+    }
+    for (Job *continuation : ready) {
+        submit(continuation);
+    }
+}
+
+void JobSystem::wait(JobCounter &counter) {
+    uint32_t thread = current_thread();
+    while (!counter.is_done()) {
+        if (Job *job = find_job(thread)) {
+            execute(job, thread);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+void JobSystem::worker_loop() {
+    register_thread();
+    uint32_t thread = current_thread();
+
+    while (_isRunning.load(std::memory_order_acquire)) {
+        if (Job *job = find_job(thread)) {
+            execute(job, thread);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        _wakeCondition.wait(lock, [this] {
+            return !_isRunning.load(std::memory_order_relaxed) ||
+                   _queuedJobs.load(std::memory_order_seq_cst) > 0;
+        });
+        _sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::set_profiling(bool isEnabled) {
+    _isProfiling.store(isEnabled, std::memory_order_relaxed);
+}
+
+void JobSystem::collect_samples(std::vector<JobSample> &out) const {
+    uint32_t threadCount = _threadCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        const std::vector<JobSample> &samples = _threads[i]->samples;
+        out.insert(out.end(), samples.begin(), samples.end());
+    }
+}
+
+void JobSystem::clear_samples() {
+    uint32_t threadCount = _threadCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        _threads[i]->samples.clear();
+    }
+}
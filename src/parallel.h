@@ -0,0 +1,236 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+/// Number of jobs started against it that have not finished yet. Jobs can be
+/// held back until a counter drops to zero, which is how dependencies
+/// between jobs are expressed.
+class JobCounter {
+  public:
+    bool is_done() const {
+        return _pending.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> _pending{0};
+    std::mutex _mutex;
+    // NOTE: Jobs waiting for this counter to drop to zero
+    std::vector<Job *> _continuations;
+};
+
+struct Job {
+    using Fn = void (*)(Job *job);
+    static constexpr size_t kPayloadSize = 64;
+
+    Fn fn;
+    JobCounter *counter;
+    const char *name;
+    /// From allocation until the job has run, queued, stolen, running or
+    /// waiting on a dependency
+    std::atomic<bool> isLive{false};
+    alignas(16) unsigned char payload[kPayloadSize];
+};
+
+/// When and where a job ran, recorded while profiling is on
+struct JobSample {
+    const char *name;
+    uint32_t thread;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+/// Bounded Chase-Lev deque. The owning thread pushes and pops at the bottom,
+/// every other thread steals from the top.
+class JobDeque {
+  public:
+    static constexpr int64_t kCapacity = 4096;
+
+    /// Owner only. Fails when the deque is full.
+    bool push(Job *job);
+    /// Owner only
+    Job *pop();
+    /// Any thread. Returns null when empty or when another thief won.
+    Job *steal();
+
+  private:
+    static constexpr int64_t kMask = kCapacity - 1;
+    static_assert((kCapacity & kMask) == 0);
+
+    alignas(64) std::atomic<int64_t> _top{0};
+    alignas(64) std::atomic<int64_t> _bottom{0};
+    std::array<std::atomic<Job *>, kCapacity> _buffer;
+};
+
+/// Work stealing scheduler. Every thread that submits jobs owns a deque,
+/// workers steal from the others when their own runs dry, and threads that
+/// wait on a counter run jobs instead of blocking. The thread calling init
+/// becomes thread 0.
+class JobSystem {
+  public:
+    static constexpr uint32_t kMaxThreads = 64;
+
+    /// A thread count of 0 uses one worker per hardware thread besides the
+    /// calling one
+    void init(uint32_t threadCount = 0);
+    void deinit();
+
+    uint32_t thread_count() const { return (uint32_t)_workers.size() + 1; }
+
+    /// Lets a thread other than the workers and the one that called init
+    /// submit and wait on jobs
+    void register_thread();
+
+    /// Runs fn() on any thread. The counter counts the job until it is done.
+    template <typename F>
+    void run(const char *name, JobCounter &counter, F &&fn);
+    /// Same as run, but the job only starts once dependency is done
+    template <typename F>
+    void run_after(JobCounter &dependency, const char *name,
+                   JobCounter &counter, F &&fn);
+    /// Runs other jobs until the counter is done
+    void wait(JobCounter &counter);
+
+    /// Calls fn(begin, end) on chunks of at most grainSize indices covering
+    /// [0, count). Chunks may run in any order and on any thread, and the
+    /// calling thread helps until all of them are done.
+    template <typename F>
+    void parallel_for(uint32_t count, uint32_t grainSize, F &&fn,
+                      const char *name = "parallel_for");
+
+    /// Jobs record a JobSample while profiling is on. Samples pile up until
+    /// cleared, so read and clear them once per frame or tick while no jobs
+    /// are running.
+    void set_profiling(bool isEnabled);
+    void collect_samples(std::vector<JobSample> &out) const;
+    void clear_samples();
+
+    /// Index of the calling thread, below kMaxThreads. Only valid on threads
+    /// that run jobs or registered themselves.
+    static uint32_t current_thread();
+
+  private:
+    // NOTE: Job slots are recycled in a ring. A thread with more jobs in
+    // flight than this runs the ones that find their slot taken inline.
+    static constexpr uint32_t kJobsPerThread = 4096;
+
+    struct ThreadState {
+        JobDeque deque;
+        std::unique_ptr<Job[]> jobs;
+        uint32_t nextJob{0};
+        std::vector<JobSample> samples;
+    };
+
+    std::vector<std::thread> _workers;
+    std::array<std::unique_ptr<ThreadState>, kMaxThreads> _threads;
+    std::atomic<uint32_t> _threadCount{0};
+    std::mutex _registerMutex;
+    std::atomic<bool> _isRunning{false};
+    std::atomic<bool> _isProfiling{false};
+
+    // NOTE: Idle workers sleep until a job is queued
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeCondition;
+    std::atomic<uint32_t> _queuedJobs{0};
+    std::atomic<uint32_t> _sleepingWorkers{0};
+
+    /// Null when the next slot of the ring is still live
+    Job *allocate_job(const char *name, JobCounter &counter);
+    void submit(Job *job);
+    void submit_after(JobCounter &dependency, Job *job);
+    Job *find_job(uint32_t thread);
+    void execute(Job *job, uint32_t thread);
+    void worker_loop();
+
+    template <typename F> static Job::Fn bind(Job *job, F &&fn);
+    template <typename F>
+    void run_range(JobCounter &counter, F *fn, uint32_t begin, uint32_t end,
+                   uint32_t grainSize, const char *name);
+};
+
+template <typename F> Job::Fn JobSystem::bind(Job *job, F &&fn) {
+    using Fn = std::decay_t<F>;
+    static_assert(sizeof(Fn) <= Job::kPayloadSize,
+                  "capture less by value or capture a pointer to the state");
+    static_assert(alignof(Fn) <= 16);
+
+    new (job->payload) Fn(std::forward<F>(fn));
+    return [](Job *job) {
+        Fn *fn = std::launder((Fn *)job->payload);
+        (*fn)();
+        fn->~Fn();
+    };
+}
+
+template <typename F>
+void JobSystem::run(const char *name, JobCounter &counter, F &&fn) {
+    Job *job = allocate_job(name, counter);
+    if (!job) {
+        fn();
+        return;
+    }
+    job->fn = bind(job, std::forward<F>(fn));
+    submit(job);
+}
+
+template <typename F>
+void JobSystem::run_after(JobCounter &dependency, const char *name,
+                          JobCounter &counter, F &&fn) {
+    Job *job = allocate_job(name, counter);
+    if (!job) {
+        wait(dependency);
+        fn();
+        return;
+    }
+    job->fn = bind(job, std::forward<F>(fn));
+    submit_after(dependency, job);
+}
+
+/**
+ * @brief Splits the range in half until it fits in a chunk, handing the upper
+ *        halves out as jobs. Thieves take the oldest and so largest halves,
+ *        which keeps the number of steals low.
+ */
+template <typename F>
+void JobSystem::run_range(JobCounter &counter, F *fn, uint32_t begin,
+                          uint32_t end, uint32_t grainSize, const char *name) {
+    while (end - begin > grainSize) {
+        uint32_t mid = begin + (end - begin) / 2;
+        run(name, counter, [this, &counter, fn, mid, end, grainSize, name] {
+            run_range(counter, fn, mid, end, grainSize, name);
+        });
+        end = mid;
+    }
+    (*fn)(begin, end);
+}
+
+template <typename F>
+void JobSystem::parallel_for(uint32_t count, uint32_t grainSize, F &&fn,
+                             const char *name) {
+    if (count == 0) {
+        return;
+    }
+
+    // NOTE: Not worth waking anyone up for a single chunk
+    if (_workers.empty() || count <= grainSize) {
+        fn(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    run_range(counter, &fn, 0, count, grainSize, name);
+    wait(counter);
+}
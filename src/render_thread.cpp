@@ -0,0 +1,173 @@
+#include "render_thread.h"
+#include <algorithm>
+#include <imgui_impl_sdl3.h>
+
+void RenderSnapshot::clear() {
+    for (entt::entity entity : entities) {
+        slots.erase(entity);
+    }
+    entities.clear();
+    transforms.clear();
+    meshIndices.clear();
+    meshes.clear();
+    fog.reset();
+    selectionRect.reset();
+}
+
+void RenderSnapshot::add(entt::entity entity, const Transform &transform,
+                         uint32_t mesh) {
+    slots.set(entity, (uint32_t)entities.size());
+
+    entities.push_back(entity);
+    transforms.push_back(transform);
+    meshIndices.push_back(mesh);
+}
+
+uint32_t RenderSnapshot::find(entt::entity entity) const {
+    const uint32_t *slot = slots.find(entity);
+    return slot ? *slot : kNoSlot;
+}
+
+void RenderThread::start(Renderer &renderer) {
+    _renderer = &renderer;
+    _isRunning = true;
+    _thread = std::thread([this] { loop(); });
+}
+
+void RenderThread::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isRunning = false;
+    }
+    _publishedCondition.notify_one();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+std::shared_ptr<RenderSnapshot> RenderThread::acquire() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const std::shared_ptr<RenderSnapshot> &snapshot : _pool) {
+        if (snapshot.use_count() == 1) {
+            snapshot->clear();
+            return snapshot;
+        }
+    }
+
+    _pool.push_back(std::make_shared<RenderSnapshot>());
+    return _pool.back();
+}
+
+void RenderThread::publish(std::shared_ptr<RenderSnapshot> snapshot) {
+    snapshot->time = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _previous = std::move(_latest);
+        _latest = std::move(snapshot);
+    }
+    _publishedCondition.notify_one();
+}
+
+void RenderThread::forward_event(const SDL_Event &event) {
+    // NOTE: The text of these events is freed by the next SDL_PollEvent,
+    // and nothing in the overlay takes text input anyway
+    if (event.type == SDL_EVENT_TEXT_INPUT ||
+        event.type == SDL_EVENT_TEXT_EDITING ||
+        event.type == SDL_EVENT_DROP_FILE ||
+        event.type == SDL_EVENT_DROP_TEXT) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events.push_back(event);
+}
+
+void RenderThread::loop() {
+    using Clock = std::chrono::steady_clock;
+
+    // NOTE: Only replaced under the mutex, so acquire sees every read of a
+    // snapshot finished once the pool holds the last reference to it
+    std::shared_ptr<const RenderSnapshot> previous;
+    std::shared_ptr<const RenderSnapshot> latest;
+    Clock::time_point lastFrame = Clock::now();
+    while (true) {
+        _renderer->wait_for_previous_frame();
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _publishedCondition.wait(
+                lock, [this] { return !_isRunning || _latest != nullptr; });
+            if (!_isRunning) {
+                previous.reset();
+                latest.reset();
+                return;
+            }
+
+            latest = _latest;
+            previous = _previous ? _previous : _latest;
+            _pendingEvents.swap(_events);
+        }
+
+        for (const SDL_Event &event : _pendingEvents) {
+            ImGui_ImplSDL3_ProcessEvent(&event);
+        }
+        _pendingEvents.clear();
+
+        // NOTE: Frames trail the simulation by one tick. A frame starting
+        // as the latest snapshot comes in shows the previous one, and it
+        // takes one tick interval to blend all the way to the latest.
+        Clock::time_point now = Clock::now();
+        float alpha = 1.f;
+        if (latest->time > previous->time) {
+            alpha = std::chrono::duration<float>(now - latest->time) /
+                    std::chrono::duration<float>(latest->time - previous->time);
+            alpha = std::clamp(alpha, 0.f, 1.f);
+        }
+
+        Uint64 frameTime = (Uint64)std::chrono::duration_cast<
+                               std::chrono::nanoseconds>(now - lastFrame)
+                               .count();
+        lastFrame = now;
+        draw(*previous, *latest, alpha, frameTime);
+    }
+}
+
+void RenderThread::draw(const RenderSnapshot &previous,
+                        const RenderSnapshot &latest, float alpha,
+                        Uint64 frameTime) {
+    // NOTE: The camera only pans and zooms, and blending two orthographic
+    // projections element by element gives the one in between
+    _renderer->set_camera_view(latest.view);
+    glm::mat4 projection = previous.projection +
+                           (latest.projection - previous.projection) * alpha;
+    _renderer->set_camera_projection(projection);
+    if (latest.selectionRect.has_value()) {
+        const std::array<glm::vec2, 2> &rect = latest.selectionRect.value();
+        _renderer->draw_selection_rect(rect[0], rect[1]);
+    }
+
+    VkCommandBuffer cmd = _renderer->begin_frame(latest.inputTime);
+    if (latest.fog != nullptr && latest.fog != _uploadedFog) {
+        _renderer->update_fog_of_war(latest.fog->texels, latest.fog->extent);
+        _uploadedFog = latest.fog;
+    }
+
+    for (size_t i = 0; i < latest.entities.size(); i++) {
+        Transform transform = latest.transforms[i];
+        uint32_t slot = previous.find(latest.entities[i]);
+        // NOTE: Units spawned since the previous snapshot have nothing to
+        // blend from
+        if (slot != RenderSnapshot::kNoSlot) {
+            const Transform &from = previous.transforms[slot];
+            transform.position(
+                glm::mix(from.position(), transform.position(), alpha));
+            transform.heading(
+                glm::slerp(from.heading(), transform.heading(), alpha));
+        }
+        _renderer->draw_scene(*latest.meshes[latest.meshIndices[i]],
+                              transform.as_matrix());
+    }
+
+    _renderer->draw(cmd);
+    _renderer->set_loop_timings(latest.loopTimings);
+    _renderer->end_frame(cmd, frameTime);
+}
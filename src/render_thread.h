@@ -0,0 +1,96 @@
+#pragma once
+#include "entity_slot_map.h"
+#include "math/transform.h"
+#include "renderer/renderer.hpp"
+#include <SDL3/SDL.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/// Fog texels of the player's team. A new one is made whenever the fog
+/// changes, so the render thread can tell by pointer whether to upload.
+struct FogSnapshot {
+    std::vector<uint32_t> texels;
+    VkExtent2D extent;
+};
+
+/// Everything the render thread draws, copied out of the simulation after
+/// the ticks of a frame. Never written once published.
+struct RenderSnapshot {
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    std::chrono::steady_clock::time_point time;
+    /// When the main thread last read input before taking the snapshot
+    std::chrono::steady_clock::time_point inputTime;
+
+    std::vector<entt::entity> entities;
+    std::vector<Transform> transforms;
+    // NOTE: Index into meshes, per entity
+    std::vector<uint32_t> meshIndices;
+    // NOTE: Where the entity is in this snapshot
+    EntitySlotMap<uint32_t> slots;
+
+    std::vector<std::shared_ptr<Scene>> meshes;
+    std::shared_ptr<const FogSnapshot> fog;
+    glm::mat4 view;
+    glm::mat4 projection;
+    std::optional<std::array<glm::vec2, 2>> selectionRect;
+    LoopTimings loopTimings;
+
+    /// Keeps the capacity, snapshots are recycled
+    void clear();
+    void add(entt::entity entity, const Transform &transform,
+             uint32_t mesh);
+    /// kNoSlot if the entity is not in the snapshot
+    uint32_t find(entt::entity entity) const;
+};
+
+/// Records and presents frames on a thread of its own, as fast as the
+/// swapchain lets it, while the simulation ticks at a fixed rate on the main
+/// thread. Every frame draws the two latest snapshots blended by how far the
+/// frame is into the next tick, so motion stays smooth at any frame rate.
+/// The render thread is the only one that records commands, waits on frame
+/// fences and presents.
+class RenderThread {
+  public:
+    void start(Renderer &renderer);
+    /// Waits for the frame in flight to be recorded
+    void stop();
+
+    /// A snapshot no frame is drawing anymore, to fill in and publish
+    std::shared_ptr<RenderSnapshot> acquire();
+    void publish(std::shared_ptr<RenderSnapshot> snapshot);
+    /// ImGui belongs to the render thread, so its events are handed over
+    /// and processed before the next frame
+    void forward_event(const SDL_Event &event);
+
+  private:
+    Renderer *_renderer{nullptr};
+    std::thread _thread;
+    std::atomic<bool> _isRunning{false};
+
+    std::mutex _mutex;
+    std::condition_variable _publishedCondition;
+    std::shared_ptr<const RenderSnapshot> _previous;
+    std::shared_ptr<const RenderSnapshot> _latest;
+    // NOTE: Every snapshot ever handed out. One is free again once the pool
+    // holds the only reference.
+    std::vector<std::shared_ptr<RenderSnapshot>> _pool;
+    std::vector<SDL_Event> _events;
+
+    // NOTE: Render thread only
+    std::shared_ptr<const FogSnapshot> _uploadedFog;
+    std::vector<SDL_Event> _pendingEvents;
+
+    void loop();
+    void draw(const RenderSnapshot &previous, const RenderSnapshot &latest,
+              float alpha, Uint64 frameTime);
+};
@@ -1,5 +1,10 @@
 #include "frustum_culling.h"
+#include "../cpu.h"
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cmath>
+#include <immintrin.h>
 
 bool vkutil::is_visible(glm::mat4 transform, Bounds bounds,
                         const glm::mat4 &viewproj) {
@@ -36,3 +41,166 @@ bool vkutil::is_visible(glm::mat4 transform, Bounds bounds,
     }
     return true;
 }
+
+void vkutil::CullingBounds::clear() {
+    boxes.resize(0);
+    radii.clear();
+}
+
+void vkutil::CullingBounds::push_back(const glm::mat4 &transform,
+                                      const Bounds &bounds) {
+    math::AABB box = bounds.get_aabb().transform(transform);
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extents = (box.max - box.min) * 0.5f;
+    boxes.centerX.push_back(center.x);
+    boxes.centerY.push_back(center.y);
+    boxes.centerZ.push_back(center.z);
+    boxes.extentX.push_back(extents.x);
+    boxes.extentY.push_back(extents.y);
+    boxes.extentZ.push_back(extents.z);
+
+    // NOTE: The sphere is scaled by the largest axis scale so it still
+    // contains the transformed mesh
+    float maxScaleSq =
+        std::max(std::max(glm::dot(glm::vec3(transform[0]),
+                                   glm::vec3(transform[0])),
+                          glm::dot(glm::vec3(transform[1]),
+                                   glm::vec3(transform[1]))),
+                 glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])));
+    radii.push_back(bounds.sphereRadius * sqrtf(maxScaleSq));
+}
+
+static inline void append_lanes(uint32_t mask, uint32_t base,
+                                std::vector<uint32_t> &visible) {
+    while (mask) {
+        visible.push_back(base + (uint32_t)std::countr_zero(mask));
+        mask &= mask - 1;
+    }
+}
+
+/// Culls 8 draws at a time, and returns how many it went through so the
+/// narrower loops can finish the rest
+SIMD_TARGET_AVX2 static uint32_t cull_avx2(const math::Frustum &frustum,
+                                           const vkutil::CullingBounds &bounds,
+                                           std::vector<uint32_t> &visible) {
+    const math::AABBArrays &boxes = bounds.boxes;
+    const float *cx = boxes.centerX.data();
+    const float *cy = boxes.centerY.data();
+    const float *cz = boxes.centerZ.data();
+    const float *ex = boxes.extentX.data();
+    const float *ey = boxes.extentY.data();
+    const float *ez = boxes.extentZ.data();
+    const float *radii = bounds.radii.data();
+    uint32_t count = (uint32_t)bounds.size();
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(cx + i);
+        __m256 y = _mm256_loadu_ps(cy + i);
+        __m256 z = _mm256_loadu_ps(cz + i);
+        __m256 negRadius =
+            _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radii + i));
+
+        __m256 distances[6];
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            distances[p] = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x),
+                              _mm256_mul_ps(_mm256_set1_ps(plane.y), y)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), z),
+                              _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(
+                inside, _mm256_cmp_ps(distances[p], negRadius, _CMP_GE_OQ));
+        }
+        if (_mm256_movemask_ps(inside) == 0) {
+            continue;
+        }
+
+        __m256 w = _mm256_loadu_ps(ex + i);
+        __m256 h = _mm256_loadu_ps(ey + i);
+        __m256 d = _mm256_loadu_ps(ez + i);
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m256 reach = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(fabsf(plane.x)), w),
+                    _mm256_mul_ps(_mm256_set1_ps(fabsf(plane.y)), h)),
+                _mm256_mul_ps(_mm256_set1_ps(fabsf(plane.z)), d));
+            inside = _mm256_and_ps(
+                inside, _mm256_cmp_ps(_mm256_add_ps(distances[p], reach),
+                                      _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        append_lanes((uint32_t)_mm256_movemask_ps(inside), i, visible);
+    }
+    return i;
+}
+
+void vkutil::cull(const math::Frustum &frustum, const CullingBounds &bounds,
+                  std::vector<uint32_t> &visible) {
+    const math::AABBArrays &boxes = bounds.boxes;
+    const float *cx = boxes.centerX.data();
+    const float *cy = boxes.centerY.data();
+    const float *cz = boxes.centerZ.data();
+    const float *ex = boxes.extentX.data();
+    const float *ey = boxes.extentY.data();
+    const float *ez = boxes.extentZ.data();
+    const float *radii = bounds.radii.data();
+    uint32_t count = (uint32_t)bounds.size();
+
+    uint32_t i = 0;
+    if (simd_level() >= SimdLevel::kAVX2) {
+        i = cull_avx2(frustum, bounds, visible);
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i);
+        __m128 y = _mm_loadu_ps(cy + i);
+        __m128 z = _mm_loadu_ps(cz + i);
+        __m128 negRadius =
+            _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radii + i));
+
+        __m128 distances[6];
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            distances[p] =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x),
+                                      _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                           _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z),
+                                      _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distances[p], negRadius));
+        }
+        if (_mm_movemask_ps(inside) == 0) {
+            continue;
+        }
+
+        __m128 w = _mm_loadu_ps(ex + i);
+        __m128 h = _mm_loadu_ps(ey + i);
+        __m128 d = _mm_loadu_ps(ez + i);
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m128 reach = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabsf(plane.x)), w),
+                           _mm_mul_ps(_mm_set1_ps(fabsf(plane.y)), h)),
+                _mm_mul_ps(_mm_set1_ps(fabsf(plane.z)), d));
+            inside = _mm_and_ps(inside,
+                                _mm_cmpge_ps(_mm_add_ps(distances[p], reach),
+                                             _mm_setzero_ps()));
+        }
+        append_lanes((uint32_t)_mm_movemask_ps(inside), i, visible);
+    }
+    for (; i < count; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            float distance =
+                plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+            float reach = fabsf(plane.x) * ex[i] + fabsf(plane.y) * ey[i] +
+                          fabsf(plane.z) * ez[i];
+            inside = distance >= -radii[i] && distance + reach >= 0.f;
+        }
+        if (inside) {
+            visible.push_back(i);
+        }
+    }
+}
@@ -1,6 +1,25 @@
 #pragma once
+#include "../math/aabb_batch.h"
+#include "../math/frustum.h"
 #include "types.h"
+#include <vector>
 
 namespace vkutil {
 bool is_visible(glm::mat4 transform, Bounds bounds, const glm::mat4 &viewproj);
+
+/// World space bounding spheres and boxes of a list of draws, one array per
+/// component so they can be culled several at a time
+struct CullingBounds {
+    math::AABBArrays boxes;
+    std::vector<float> radii;
+
+    size_t size() const { return radii.size(); }
+    void clear();
+    void push_back(const glm::mat4 &transform, const Bounds &bounds);
 };
+
+/// Appends the index of every draw whose bounds overlap the frustum. Spheres
+/// reject first, and boxes are only tested for batches with a survivor.
+void cull(const math::Frustum &frustum, const CullingBounds &bounds,
+          std::vector<uint32_t> &visible);
+}; // namespace vkutil
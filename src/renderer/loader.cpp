@@ -488,5 +488,7 @@ std::optional<std::shared_ptr<Scene>> loadGltf(Renderer *renderer,
         }
     }
 
+    scene.localBounds = scene.get_local_aabb();
+
     return scenePtr;
 }
@@ -1,5 +1,4 @@
 #include "depth_pass.h"
-#include "../frustum_culling.h"
 #include "builder.h"
 
 void DepthPassPipeline::init(VkDevice device, VkFormat imageFormat,
@@ -53,8 +52,9 @@ void DepthPassPipeline::init(VkDevice device, VkFormat imageFormat,
 
 void DepthPassPipeline::draw(VkCommandBuffer cmd,
                              VkDescriptorSet sceneDescriptor,
-                             glm::mat4 lightViewproj, uint32_t resolution,
-                             const std::vector<MeshDrawCommand> &drawCommands) {
+                             uint32_t resolution,
+                             const std::vector<MeshDrawCommand> &drawCommands,
+                             const std::vector<uint32_t> &visibleIndices) {
     VkViewport shadowViewport = {};
     shadowViewport.x = 0.0f;
     shadowViewport.y = 0.0f;
@@ -76,12 +76,8 @@ void DepthPassPipeline::draw(VkCommandBuffer cmd,
                             nullptr);
 
     VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
-    for (const auto &drawCmd : drawCommands) {
-        if (!vkutil::is_visible(drawCmd.transform, drawCmd.bounds,
-                                lightViewproj)) {
-            continue;
-        }
-
+    for (uint32_t index : visibleIndices) {
+        const MeshDrawCommand &drawCmd = drawCommands[index];
         if (drawCmd.indexBuffer != lastIndexBuffer) {
             lastIndexBuffer = drawCmd.indexBuffer;
             vkCmdBindIndexBuffer(cmd, drawCmd.indexBuffer, 0,
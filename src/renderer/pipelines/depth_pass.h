@@ -7,8 +7,9 @@ class DepthPassPipeline {
               VkDescriptorSetLayout sceneLayout);
     void deinit();
     void draw(VkCommandBuffer cmd, VkDescriptorSet sceneDescriptor,
-              glm::mat4 lightViewproj, uint32_t resolution,
-              const std::vector<MeshDrawCommand> &drawCommands);
+              uint32_t resolution,
+              const std::vector<MeshDrawCommand> &drawCommands,
+              const std::vector<uint32_t> &visibleIndices);
 
   private:
     VkPipeline _pipeline;
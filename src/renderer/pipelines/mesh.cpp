@@ -1,5 +1,4 @@
 #include "mesh.h"
-#include "../frustum_culling.h"
 #include "builder.h"
 #include <algorithm>
 
@@ -129,16 +128,9 @@ void MeshPipeline::init(VkDevice device, VkFormat drawImageFormat,
 }
 
 void MeshPipeline::draw(const RenderContext &ctx,
-                        const std::vector<MeshDrawCommand> &drawCommands) {
-    std::vector<uint32_t> objectIndices;
-    objectIndices.reserve(drawCommands.size());
-
-    for (int i = 0; i < drawCommands.size(); i++) {
-        if (vkutil::is_visible(drawCommands[i].transform,
-                               drawCommands[i].bounds, ctx.viewproj)) {
-            objectIndices.push_back(i);
-        }
-    }
+                        const std::vector<MeshDrawCommand> &drawCommands,
+                        const std::vector<uint32_t> &visibleIndices) {
+    std::vector<uint32_t> objectIndices = visibleIndices;
 
     // sort the opaque surfaces by material and mesh
     std::sort(objectIndices.begin(), objectIndices.end(),
@@ -37,7 +37,8 @@ class MeshPipeline {
               VkDescriptorSetLayout shadowDescriptorSetLayout);
     void deinit();
     void draw(const RenderContext &ctx,
-              const std::vector<MeshDrawCommand> &drawCommands);
+              const std::vector<MeshDrawCommand> &drawCommands,
+              const std::vector<uint32_t> &visibleIndices);
 
     MaterialInstance
     write_material(VkDevice device, MaterialPass pass,
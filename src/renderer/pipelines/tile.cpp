@@ -1,15 +1,15 @@
 #include "tile.h"
-#include "../frustum_culling.h"
 #include "../renderer.hpp"
 #include "builder.h"
 #include "vk_mem_alloc.h"
 #include <glm/ext/matrix_transform.hpp>
 
 void TilePipeline::init(Renderer *renderer, VkDescriptorSetLayout sceneLayout,
-                        VkDescriptorSetLayout shadowMapLayout) {
+                        VkDescriptorSetLayout shadowMapLayout,
+                        VkDescriptorSetLayout fogOfWarLayout) {
     _renderer = renderer;
     init_buffers();
-    init_pipeline(sceneLayout, shadowMapLayout);
+    init_pipeline(sceneLayout, shadowMapLayout, fogOfWarLayout);
 }
 
 void TilePipeline::deinit() {
@@ -18,7 +18,8 @@ void TilePipeline::deinit() {
 }
 
 void TilePipeline::draw(const RenderContext &ctx,
-                        const std::vector<TileDrawCommand> &drawCommands) {
+                        const std::vector<TileDrawCommand> &drawCommands,
+                        const std::vector<uint32_t> &visibleIndices) {
     VkViewport viewport = {};
     viewport.x = 0;
     viewport.y = 0;
@@ -38,21 +39,17 @@ void TilePipeline::draw(const RenderContext &ctx,
     vkCmdBindPipeline(ctx.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
 
     VkDescriptorSet descriptorSets[] = {ctx.globalDescriptorSet,
-                                        ctx.shadowMapSet};
+                                        ctx.shadowMapSet, ctx.fogOfWarSet};
     vkCmdBindDescriptorSets(ctx.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            _pipelineLayout, 0, 2, &descriptorSets[0], 0,
+                            _pipelineLayout, 0, 3, &descriptorSets[0], 0,
                             nullptr);
 
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(ctx.cmd, 0, 1, &_vertexBuffer.buffer, offsets);
     vkCmdBindIndexBuffer(ctx.cmd, _indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-    for (auto &drawCommand : drawCommands) {
-        if (!vkutil::is_visible(drawCommand.transform, drawCommand.bounds,
-                                ctx.viewproj)) {
-            continue;
-        }
-
+    for (uint32_t index : visibleIndices) {
+        const TileDrawCommand &drawCommand = drawCommands[index];
         vkCmdBindVertexBuffers(ctx.cmd, 1, 1,
                                &drawCommand.instanceBuffer.buffer, offsets);
 
@@ -67,7 +64,8 @@ void TilePipeline::draw(const RenderContext &ctx,
 }
 
 void TilePipeline::init_pipeline(VkDescriptorSetLayout sceneLayout,
-                                 VkDescriptorSetLayout shadowMapLayout) {
+                                 VkDescriptorSetLayout shadowMapLayout,
+                                 VkDescriptorSetLayout fogOfWarLayout) {
     VkShaderModule tileFragShader;
     if (!vkutil::load_shader_module("shaders/spv/tile.frag.spv",
                                     _renderer->_device, &tileFragShader)) {
@@ -87,10 +85,11 @@ void TilePipeline::init_pipeline(VkDescriptorSetLayout sceneLayout,
     pushConstantRange.size = sizeof(glm::mat4);
     pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-    VkDescriptorSetLayout layouts[] = {sceneLayout, shadowMapLayout};
+    VkDescriptorSetLayout layouts[] = {sceneLayout, shadowMapLayout,
+                                       fogOfWarLayout};
     VkPipelineLayoutCreateInfo tileLayoutInfo = {};
     tileLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    tileLayoutInfo.setLayoutCount = 2;
+    tileLayoutInfo.setLayoutCount = 3;
     tileLayoutInfo.pSetLayouts = layouts;
     tileLayoutInfo.pushConstantRangeCount = 1;
     tileLayoutInfo.pPushConstantRanges = &pushConstantRange;
@@ -83,10 +83,12 @@ class Renderer;
 class TilePipeline {
   public:
     void init(Renderer *renderer, VkDescriptorSetLayout sceneLayout,
-              VkDescriptorSetLayout shadowMapLayout);
+              VkDescriptorSetLayout shadowMapLayout,
+              VkDescriptorSetLayout fogOfWarLayout);
     void deinit();
     void draw(const RenderContext &ctx,
-              const std::vector<TileDrawCommand> &drawCommands);
+              const std::vector<TileDrawCommand> &drawCommands,
+              const std::vector<uint32_t> &visibleIndices);
 
   private:
     Renderer *_renderer;
@@ -96,6 +98,7 @@ class TilePipeline {
     AllocatedBuffer _indexBuffer;
 
     void init_pipeline(VkDescriptorSetLayout sceneLayout,
-                       VkDescriptorSetLayout shadowMapLayout);
+                       VkDescriptorSetLayout shadowMapLayout,
+                       VkDescriptorSetLayout fogOfWarLayout);
     void init_buffers();
 };
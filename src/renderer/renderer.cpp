@@ -1,4 +1,5 @@
 #include "renderer.hpp"
+#include "../cpu.h"
 #include "SDL3/SDL_vulkan.h"
 #include "image.h"
 #include "imgui.h"
@@ -17,8 +18,12 @@
 Renderer *loadedRenderer = nullptr;
 Renderer &Renderer::Get() { return *loadedRenderer; }
 
-void Renderer::init(SDL_Window *window) {
+void Renderer::init(SDL_Window *window, const RendererConfig &config) {
+    assert(config.frameOverlap >= 2 &&
+           config.frameOverlap <= MAX_FRAME_OVERLAP);
     _window = window;
+    _frameOverlap = config.frameOverlap;
+    _frameMode = config.frameMode;
     _resizeRequested = false;
     _instance = create_vulkan_instance(window);
     _surface = create_surface(window, _instance);
@@ -51,12 +56,19 @@ void Renderer::init(SDL_Window *window) {
     init_sync_structures();
     init_descriptors();
     init_shadow_map();
+    init_fog_of_war();
     init_pipelines();
     init_imgui();
 
     init_default_data();
 
     _drawCommands.reserve(1024);
+
+    const SDL_DisplayMode *displayMode =
+        SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+    if (displayMode != nullptr && displayMode->refresh_rate > 0.f) {
+        _refreshInterval = 1000.f / displayMode->refresh_rate;
+    }
 }
 
 void Renderer::init_default_data() {
@@ -110,12 +122,12 @@ void Renderer::init_default_data() {
 }
 
 void Renderer::init_commands(uint32_t queueFamilyIndex) {
-    for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
+    for (uint32_t i = 0; i < _frameOverlap; i++) {
         _frames[i]._commandPool =
             create_command_pool(_device, queueFamilyIndex);
         _frames[i]._mainCommandBuffer =
             create_command_buffer(_device, _frames[i]._commandPool);
-        _mainDeletionQueue.push_function([&]() {
+        _mainDeletionQueue.push_function([this, i]() {
             vkDestroyCommandPool(_device, _frames[i]._commandPool, nullptr);
         });
     }
@@ -147,14 +159,16 @@ void Renderer::init_swapchain() {
 void Renderer::init_pipelines() {
     _depthPassPipeline.init(_device, _shadowMap.image.format,
                             _gpuSceneDataDescriptorLayout);
-    _tilePipeline.init(this, _gpuSceneDataDescriptorLayout, _shadowMap.layout);
+    _tilePipeline.init(this, _gpuSceneDataDescriptorLayout, _shadowMap.layout,
+                       _fogOfWar.layout);
     _meshPipeline.init(_device, _drawImage.format, _depthImage.format,
                        _gpuSceneDataDescriptorLayout, _shadowMap.layout);
 }
 
 void Renderer::init_descriptors() {
     std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}};
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}};
 
     _globalDescriptorAllocator.init(_device, 10, sizes);
 
@@ -174,7 +188,7 @@ void Renderer::init_descriptors() {
                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
     writer.update_set(_device, _drawImageDescriptors);
 
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
+    for (uint32_t i = 0; i < _frameOverlap; i++) {
         std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frameSizes = {
             {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3},
             {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3},
@@ -185,8 +199,9 @@ void Renderer::init_descriptors() {
         _frames[i]._frameDescriptors = DescriptorAllocatorGrowable{};
         _frames[i]._frameDescriptors.init(_device, 1000, frameSizes);
 
-        _mainDeletionQueue.push_function(
-            [&]() { _frames[i]._frameDescriptors.destroy_pools(_device); });
+        _mainDeletionQueue.push_function([this, i]() {
+            _frames[i]._frameDescriptors.destroy_pools(_device);
+        });
     }
 
     // TODO: Having separate descriptor layouts for samplers and images is
@@ -263,20 +278,131 @@ void Renderer::init_shadow_map() {
     });
 }
 
+void Renderer::init_fog_of_war() {
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(
+        vkCreateSampler(_device, &samplerInfo, nullptr, &_fogOfWar.sampler));
+
+    {
+        DescriptorLayoutBuilder builder;
+        builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        _fogOfWar.layout = builder.build(_device, VK_SHADER_STAGE_FRAGMENT_BIT);
+    }
+
+    _fogOfWar.descriptor =
+        _globalDescriptorAllocator.allocate(_device, _fogOfWar.layout);
+
+    // NOTE: Until the game provides its fog of war everything is visible
+    create_fog_of_war_image(VkExtent2D{1, 1});
+    uint32_t visible[2] = {UINT32_MAX, UINT32_MAX};
+    update_fog_of_war(visible, VkExtent2D{1, 1});
+
+    _mainDeletionQueue.push_function([&]() {
+        if (_fogOfWar.pendingUpload.has_value()) {
+            destroy_buffer(_fogOfWar.pendingUpload.value());
+        }
+        destroy_image(_fogOfWar.image);
+        vkDestroySampler(_device, _fogOfWar.sampler, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _fogOfWar.layout, nullptr);
+    });
+}
+
+void Renderer::create_fog_of_war_image(VkExtent2D extent) {
+    // NOTE: Each texel holds the visible and explored bits of one tile chunk
+    // row, the fragment shader picks out the bit of its own tile
+    _fogOfWar.image = create_image(
+        VkExtent3D{extent.width, extent.height, 1}, VK_FORMAT_R32G32_UINT,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+    immediate_submit([&](VkCommandBuffer cmd) {
+        vkutil::transition_image(cmd, _fogOfWar.image.image,
+                                 VK_IMAGE_LAYOUT_UNDEFINED,
+                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    });
+
+    DescriptorWriter writer;
+    writer.write_image(0, _fogOfWar.image.imageView, _fogOfWar.sampler,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.update_set(_device, _fogOfWar.descriptor);
+}
+
+void Renderer::update_fog_of_war(std::span<const uint32_t> texels,
+                                 VkExtent2D extent) {
+    assert(texels.size() == (size_t)extent.width * extent.height * 2);
+
+    if (extent.width != _fogOfWar.image.extent.width ||
+        extent.height != _fogOfWar.image.extent.height) {
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            vkDeviceWaitIdle(_device);
+        }
+        destroy_image(_fogOfWar.image);
+        create_fog_of_war_image(extent);
+    }
+
+    if (_fogOfWar.pendingUpload.has_value()) {
+        // NOTE: Never recorded, so the GPU cannot be using it yet
+        destroy_buffer(_fogOfWar.pendingUpload.value());
+    }
+
+    AllocatedBuffer staging =
+        create_buffer(texels.size_bytes(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+    memcpy(staging.info.pMappedData, texels.data(), texels.size_bytes());
+    _fogOfWar.pendingUpload = staging;
+}
+
+void Renderer::upload_fog_of_war(VkCommandBuffer cmd) {
+    if (!_fogOfWar.pendingUpload.has_value()) {
+        return;
+    }
+
+    AllocatedBuffer staging = _fogOfWar.pendingUpload.value();
+    _fogOfWar.pendingUpload.reset();
+
+    vkutil::transition_image(cmd, _fogOfWar.image.image,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = _fogOfWar.image.extent;
+    vkCmdCopyBufferToImage(cmd, staging.buffer, _fogOfWar.image.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &copyRegion);
+
+    vkutil::transition_image(cmd, _fogOfWar.image.image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    get_current_frame()._deletionQueue.push_function(
+        [=, this]() { destroy_buffer(staging); });
+}
+
 void Renderer::init_sync_structures() {
     VkSemaphoreCreateInfo semaphore_create_info = {};
     semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     VkFenceCreateInfo fence_create_info = {};
     fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
+    for (uint32_t i = 0; i < _frameOverlap; i++) {
         VK_CHECK(vkCreateFence(_device, &fence_create_info, nullptr,
                                &_frames[i]._renderFence));
         VK_CHECK(vkCreateSemaphore(_device, &semaphore_create_info, nullptr,
                                    &_frames[i]._renderSemaphore));
         VK_CHECK(vkCreateSemaphore(_device, &semaphore_create_info, nullptr,
                                    &_frames[i]._swapchainSemaphore));
-        _mainDeletionQueue.push_function([&]() {
+        _mainDeletionQueue.push_function([this, i]() {
             vkDestroySemaphore(_device, _frames[i]._renderSemaphore, nullptr);
             vkDestroySemaphore(_device, _frames[i]._swapchainSemaphore,
                                nullptr);
@@ -358,7 +484,10 @@ void Renderer::deinit() {
 }
 
 void Renderer::resize_swapchain() {
-    vkDeviceWaitIdle(_device);
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        vkDeviceWaitIdle(_device);
+    }
     destroy_swapchain();
     init_swapchain();
     _resizeRequested = false;
@@ -382,6 +511,7 @@ void Renderer::update_tile_draw_commands(
 
     _tileDrawCommands.clear();
     _tileDrawCommands.resize(inputs.size());
+    _tileCullingBounds.clear();
 
     for (int i = 0; i < inputs.size(); i++) {
         TileDrawCommand cmd;
@@ -406,6 +536,7 @@ void Renderer::update_tile_draw_commands(
         memcpy(data, inputs[i].instances.data(), bufferSize);
 
         _tileDrawCommands[i] = cmd;
+        _tileCullingBounds.push_back(cmd.transform, cmd.bounds);
     }
 }
 
@@ -430,6 +561,23 @@ void Renderer::draw(VkCommandBuffer cmd) {
                         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
     writer.update_set(_device, globalDescriptor);
 
+    upload_fog_of_war(cmd);
+
+    _meshCullingBounds.clear();
+    for (const MeshDrawCommand &drawCommand : _drawCommands) {
+        _meshCullingBounds.push_back(drawCommand.transform, drawCommand.bounds);
+    }
+
+    math::Frustum cameraFrustum = math::frustum_from_matrix(sceneData.viewproj);
+    math::Frustum lightFrustum =
+        math::frustum_from_matrix(sceneData.lightViewproj);
+    _visibleTiles.clear();
+    _visibleMeshes.clear();
+    _visibleShadowCasters.clear();
+    vkutil::cull(cameraFrustum, _tileCullingBounds, _visibleTiles);
+    vkutil::cull(cameraFrustum, _meshCullingBounds, _visibleMeshes);
+    vkutil::cull(lightFrustum, _meshCullingBounds, _visibleShadowCasters);
+
     vkutil::transition_image(cmd, _shadowMap.image.image,
                              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
@@ -455,8 +603,8 @@ void Renderer::draw(VkCommandBuffer cmd) {
 
     vkCmdBeginRendering(cmd, &shadowRenderInfo);
 
-    _depthPassPipeline.draw(cmd, globalDescriptor, sceneData.lightViewproj,
-                            _shadowMap.resolution, _drawCommands);
+    _depthPassPipeline.draw(cmd, globalDescriptor, _shadowMap.resolution,
+                            _drawCommands, _visibleShadowCasters);
 
     vkCmdEndRendering(cmd);
 
@@ -504,26 +652,51 @@ void Renderer::draw(VkCommandBuffer cmd) {
         .drawExtent = _drawExtent,
         .globalDescriptorSet = globalDescriptor,
         .shadowMapSet = _shadowMap.descriptor,
+        .fogOfWarSet = _fogOfWar.descriptor,
         .viewproj = sceneData.viewproj,
     };
 
-    _tilePipeline.draw(ctx, _tileDrawCommands);
-    _meshPipeline.draw(ctx, _drawCommands);
+    _tilePipeline.draw(ctx, _tileDrawCommands, _visibleTiles);
+    _meshPipeline.draw(ctx, _drawCommands, _visibleMeshes);
 
     vkCmdEndRendering(cmd);
 }
 
-VkCommandBuffer Renderer::begin_frame() {
+void Renderer::wait_for_frame(FrameData &frame) {
+    VK_CHECK(
+        vkWaitForFences(_device, 1, &frame._renderFence, VK_TRUE, UINT64_MAX));
+    if (!frame.inputTime.has_value()) {
+        return;
+    }
+
+    // NOTE: Only exact when the wait blocked, a fence that signaled long ago
+    // makes the frame look later than it was. Smoothed so the number can be
+    // read.
+    float latency = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - *frame.inputTime)
+                        .count() +
+                    _refreshInterval;
+    _stats.inputLatency += (latency - _stats.inputLatency) * 0.1f;
+    frame.inputTime.reset();
+}
+
+void Renderer::wait_for_previous_frame() {
+    if (_frameMode == FrameMode::kLowLatency) {
+        wait_for_frame(get_previous_frame());
+    }
+}
+
+VkCommandBuffer
+Renderer::begin_frame(std::chrono::steady_clock::time_point inputTime) {
     if (_resizeRequested) {
         resize_swapchain();
     }
 
     FrameData *currentFrame = &get_current_frame();
-    VK_CHECK(vkWaitForFences(_device, 1, &currentFrame->_renderFence, VK_TRUE,
-                             UINT64_MAX));
+    wait_for_frame(*currentFrame);
     currentFrame->_deletionQueue.flush();
     currentFrame->_frameDescriptors.clear_pools(_device);
-    vkResetFences(_device, 1, &currentFrame->_renderFence);
+    currentFrame->inputTime = inputTime;
 
     _drawExtent.width =
         std::min(_swapchainExtent.width, _drawImage.extent.width);
@@ -551,7 +724,7 @@ VkCommandBuffer Renderer::begin_frame() {
     return cmd;
 }
 
-void Renderer::end_frame(VkCommandBuffer cmd, Uint64 dt) {
+void Renderer::end_frame(VkCommandBuffer cmd, Uint64 frameTime) {
     FrameData *currentFrame = &get_current_frame();
     uint32_t imageIndex;
     VkResult acquireResult = vkAcquireNextImageKHR(
@@ -559,6 +732,7 @@ void Renderer::end_frame(VkCommandBuffer cmd, Uint64 dt) {
         VK_NULL_HANDLE, &imageIndex);
     if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
         _resizeRequested = true;
+        currentFrame->inputTime.reset();
         return;
     }
 
@@ -576,7 +750,7 @@ void Renderer::end_frame(VkCommandBuffer cmd, Uint64 dt) {
                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    prepare_imgui(dt);
+    prepare_imgui(frameTime);
     draw_imgui(cmd, _swapchainImageViews[imageIndex]);
 
     vkutil::transition_image(cmd, _swapchainImages[imageIndex],
@@ -605,6 +779,10 @@ void Renderer::end_frame(VkCommandBuffer cmd, Uint64 dt) {
     submitInfo.commandBufferInfoCount = 1;
     submitInfo.pCommandBufferInfos = &cmdSubmitInfo;
 
+    // NOTE: Reset only now, a frame dropped before the submit would leave the
+    // fence unsignaled and the next wait on it would never return
+    VK_CHECK(vkResetFences(_device, 1, &currentFrame->_renderFence));
+    std::unique_lock<std::mutex> lock(_queueMutex);
     VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submitInfo,
                             currentFrame->_renderFence));
 
@@ -620,6 +798,7 @@ void Renderer::end_frame(VkCommandBuffer cmd, Uint64 dt) {
 
     VkResult presentResult =
         vkQueuePresentKHR(_presentationQueue, &present_info);
+    lock.unlock();
     if (presentResult == VK_ERROR_OUT_OF_DATE_KHR) {
         _resizeRequested = true;
         return;
@@ -682,20 +861,55 @@ void Renderer::draw_scene_node(const Scene &scene, size_t nodeIndex,
     }
 }
 
-void Renderer::prepare_imgui(Uint64 dt) {
+/// One line of percentiles in milliseconds
+static void text_percentiles(const char *label, const TimingPercentiles &p) {
+    ImGui::Text("%s p50 %.2f p95 %.2f p99 %.2f max %.2f ms", label,
+                (double)p.p50 / 1e6, (double)p.p95 / 1e6, (double)p.p99 / 1e6,
+                (double)p.max / 1e6);
+}
+
+void Renderer::prepare_imgui(Uint64 frameTime) {
+    _frameTimes.record(frameTime);
+    if (_frameNumber % 60 == 0) {
+        _stats.frameTimes = _frameTimes.percentiles();
+    }
+
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplSDL3_NewFrame();
     ImGui::NewFrame();
     ImGui::Begin("Stats");
-    ImGui::Text("frametime %lu ms", dt);
-    ImGui::Text("fps %f", 1000.f / (float)dt);
+    ImGui::Text("frametime %.2f ms", (double)frameTime / 1e6);
+    ImGui::Text("fps %.1f", 1e9 / (double)std::max<Uint64>(frameTime, 1));
     ImGui::Text("drawtime %lu ms", _stats.meshDrawTime);
     ImGui::Text("triangles %i", _stats.triangleCount);
     ImGui::Text("draws %i", _stats.drawcallCount);
+    ImGui::Text("input latency %.1f ms", _stats.inputLatency);
+    text_percentiles("frame", _stats.frameTimes);
+    text_percentiles("loop", _stats.loop.frameTimes);
+    text_percentiles("tick late", _stats.loop.tickLateness);
+    ImGui::Text("dropped ticks %lu", _stats.loop.droppedTicks);
+    ImGui::Text("frames in flight %u", _frameOverlap);
+    bool isLowLatency = _frameMode == FrameMode::kLowLatency;
+    if (ImGui::Checkbox("low latency", &isLowLatency)) {
+        _frameMode =
+            isLowLatency ? FrameMode::kLowLatency : FrameMode::kThroughput;
+    }
+    ImGui::Text("simd %s", simd_level_name(simd_level()));
     ImGui::End();
+    if (_selectionRect.has_value()) {
+        const std::array<glm::vec2, 2> &rect = _selectionRect.value();
+        ImGui::GetForegroundDrawList()->AddRect(
+            ImVec2(rect[0].x, rect[0].y), ImVec2(rect[1].x, rect[1].y),
+            IM_COL32(0, 255, 0, 255));
+        _selectionRect.reset();
+    }
     ImGui::Render();
 }
 
+void Renderer::draw_selection_rect(glm::vec2 start, glm::vec2 end) {
+    _selectionRect = std::array<glm::vec2, 2>{start, end};
+}
+
 void Renderer::draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView) {
     VkRenderingAttachmentInfo colorAttachment = create_color_attachment_info(
         targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
@@ -712,6 +926,7 @@ void Renderer::draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView) {
 
 void Renderer::immediate_submit(
     std::function<void(VkCommandBuffer cmd)> &&function) {
+    std::lock_guard<std::mutex> lock(_queueMutex);
     VK_CHECK(vkResetFences(_device, 1, &_immFence));
     VK_CHECK(vkResetCommandBuffer(_immCommandBuffer, 0));
 
@@ -1,5 +1,7 @@
 #pragma once
+#include "../tick_stats.h"
 #include "descriptor.h"
+#include "frustum_culling.h"
 #include "init.h"
 #include "loader.h"
 #include "pipelines/depth_pass.h"
@@ -9,13 +11,20 @@
 #include "types.h"
 #include "vertex.h"
 #include <SDL3/SDL.h>
+#include <array>
+#include <chrono>
 #include <deque>
 #include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <vector>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
-constexpr unsigned int FRAME_OVERLAP = 2;
+// NOTE: How many frames the CPU may record ahead of the GPU is set at init,
+// this only bounds the per-frame resources
+constexpr unsigned int MAX_FRAME_OVERLAP = 3;
 
 struct DeletionQueue {
     std::deque<std::function<void()>> deletors;
@@ -43,12 +52,35 @@ struct FrameData {
 
     VkCommandPool _commandPool;
     VkCommandBuffer _mainCommandBuffer;
+
+    // NOTE: When the input this frame shows was read, cleared once the
+    // frame is seen finished and its latency recorded
+    std::optional<std::chrono::steady_clock::time_point> inputTime;
 };
 
 struct RenderStats {
     int triangleCount;
     int drawcallCount;
     Uint64 meshDrawTime;
+    /// From reading input to the frame showing it, in milliseconds. The GPU
+    /// finishing is taken from the fence, the scanout is one refresh.
+    float inputLatency{0.f};
+    TimingPercentiles frameTimes;
+    LoopTimings loop;
+};
+
+enum class FrameMode {
+    /// The CPU records up to frameOverlap frames ahead of the GPU
+    kThroughput,
+    /// The next frame is only started once the GPU finished the last one,
+    /// so it draws the freshest input at the cost of frame rate
+    kLowLatency,
+};
+
+struct RendererConfig {
+    /// Frames in flight, 2 or 3
+    uint32_t frameOverlap{2};
+    FrameMode frameMode{FrameMode::kThroughput};
 };
 
 struct ShadowMapResources {
@@ -59,18 +91,33 @@ struct ShadowMapResources {
     uint32_t resolution = 2048;
 };
 
+struct FogOfWarResources {
+    AllocatedImage image;
+    VkDescriptorSetLayout layout;
+    VkDescriptorSet descriptor;
+    VkSampler sampler;
+    // NOTE: Staging buffer that gets copied into the image when the next frame
+    // is recorded
+    std::optional<AllocatedBuffer> pendingUpload;
+};
+
 class Renderer {
   private:
     SDL_Window *_window;
     VkInstance _instance;
     VkPhysicalDevice _physicalDevice;
     VkSurfaceKHR _surface;
-    FrameData _frames[FRAME_OVERLAP];
+    FrameData _frames[MAX_FRAME_OVERLAP];
+    uint32_t _frameOverlap{2};
     uint32_t _frameNumber;
+    FrameMode _frameMode{FrameMode::kThroughput};
+    // NOTE: In milliseconds, 0 if the display does not report its rate
+    float _refreshInterval{0.f};
     VkQueue _graphicsQueue;
     VkQueue _presentationQueue;
     DeletionQueue _mainDeletionQueue;
     RenderStats _stats;
+    TimingRing _frameTimes;
 
     VkSwapchainKHR _swapchain;
     VkExtent2D _swapchainExtent;
@@ -78,6 +125,9 @@ class Renderer {
     std::vector<VkImage> _swapchainImages;
     std::vector<VkImageView> _swapchainImageViews;
 
+    // NOTE: Meshes are loaded on the main thread while the render thread
+    // draws, and a queue takes submits from one thread at a time
+    std::mutex _queueMutex;
     VkFence _immFence;
     VkCommandBuffer _immCommandBuffer;
     VkCommandPool _immCommandPool;
@@ -92,7 +142,16 @@ class Renderer {
     std::vector<TileDrawCommand> _tileDrawCommands;
     std::vector<MeshDrawCommand> _drawCommands;
 
+    // NOTE: Tile bounds only change with the tile map, mesh bounds are
+    // rebuilt from the draw commands every frame
+    vkutil::CullingBounds _tileCullingBounds;
+    vkutil::CullingBounds _meshCullingBounds;
+    std::vector<uint32_t> _visibleTiles;
+    std::vector<uint32_t> _visibleMeshes;
+    std::vector<uint32_t> _visibleShadowCasters;
+
     ShadowMapResources _shadowMap;
+    FogOfWarResources _fogOfWar;
 
     GPUSceneData sceneData;
 
@@ -102,12 +161,19 @@ class Renderer {
 
     glm::mat4 _cameraViewMatrix;
 
-    void prepare_imgui(Uint64 dt);
+    // NOTE: Corners of the marquee to draw this frame, in window coordinates
+    std::optional<std::array<glm::vec2, 2>> _selectionRect;
+
+    void prepare_imgui(Uint64 frameTime);
     void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
     void update_scene();
     FrameData &get_current_frame() {
-        return _frames[_frameNumber % FRAME_OVERLAP];
+        return _frames[_frameNumber % _frameOverlap];
+    };
+    FrameData &get_previous_frame() {
+        return _frames[(_frameNumber + _frameOverlap - 1) % _frameOverlap];
     };
+    void wait_for_frame(FrameData &frame);
     void draw_scene_node(const Scene &scene, size_t nodeIndex,
                          const glm::mat4 &worldTransform);
 
@@ -118,6 +184,9 @@ class Renderer {
     void init_sync_structures();
     void init_descriptors();
     void init_shadow_map();
+    void init_fog_of_war();
+    void create_fog_of_war_image(VkExtent2D extent);
+    void upload_fog_of_war(VkCommandBuffer cmd);
     void init_imgui();
     void destroy_swapchain();
 
@@ -141,12 +210,24 @@ class Renderer {
 
     MeshPipeline _meshPipeline;
 
-    void init(SDL_Window *window);
+    void init(SDL_Window *window,
+              const RendererConfig &config = RendererConfig{});
     void deinit();
-    VkCommandBuffer begin_frame();
+    /// Blocks until the GPU finished the last frame in low latency mode,
+    /// returns right away otherwise. Call it before reading the state the
+    /// next frame draws.
+    void wait_for_previous_frame();
+    /// inputTime is when the input the frame shows was read
+    VkCommandBuffer
+    begin_frame(std::chrono::steady_clock::time_point inputTime);
     void draw_world(VkCommandBuffer cmd);
     void draw(VkCommandBuffer cmd);
-    void end_frame(VkCommandBuffer cmd, Uint64 dt);
+    /// frameTime is the time since the last frame, in nanoseconds
+    void end_frame(VkCommandBuffer cmd, Uint64 frameTime);
+    /// Shown in the stats window
+    void set_loop_timings(const LoopTimings &timings) {
+        _stats.loop = timings;
+    }
 
     VkExtent2D swapchainExtent() { return _swapchainExtent; };
 
@@ -162,6 +243,8 @@ class Renderer {
     void draw_scene(const Scene &scene, const glm::mat4 &worldTransform);
     void write_draw_command(MeshDrawCommand &&cmd);
     void update_tile_draw_commands(std::vector<TileRenderingInput> inputs);
+    void update_fog_of_war(std::span<const uint32_t> texels, VkExtent2D extent);
+    void draw_selection_rect(glm::vec2 start, glm::vec2 end);
 
     AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage,
                                   VmaMemoryUsage memoryUsage);
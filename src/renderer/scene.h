@@ -62,6 +62,9 @@ struct Scene {
 
     AllocatedBuffer materialDataBuffer;
 
+    // NOTE: Cached result of get_local_aabb, filled in once loading is done
+    std::optional<math::AABB> localBounds{std::nullopt};
+
     ~Scene();
 
     std::optional<math::AABB> get_local_aabb() const;
@@ -80,6 +80,7 @@ struct RenderContext {
     VkExtent2D drawExtent;
     VkDescriptorSet globalDescriptorSet;
     VkDescriptorSet shadowMapSet;
+    VkDescriptorSet fogOfWarSet;
     glm::mat4 viewproj;
 };
 
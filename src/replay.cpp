@@ -0,0 +1,92 @@
+#include "replay.h"
+
+static constexpr uint32_t kReplayMagic = 0x594c5052; // "RPLY"
+// NOTE: Bump whenever GameCommand or ReplayHeader change
+static constexpr uint32_t kReplayVersion = 2;
+
+bool ReplayRecorder::open(const char *path, const ReplayHeader &header) {
+    _file = fopen(path, "wb");
+    if (!_file) {
+        fprintf(stderr, "could not open %s for recording\n", path);
+        return false;
+    }
+
+    _tickCount = 0;
+    fwrite(&kReplayMagic, sizeof(kReplayMagic), 1, _file);
+    fwrite(&kReplayVersion, sizeof(kReplayVersion), 1, _file);
+    fwrite(&header, sizeof(header), 1, _file);
+    return true;
+}
+
+void ReplayRecorder::record_tick(std::span<const GameCommand> commands) {
+    uint32_t count = (uint32_t)commands.size();
+    if (fwrite(&count, sizeof(count), 1, _file) != 1 ||
+        fwrite(commands.data(), sizeof(GameCommand), count, _file) != count) {
+        fprintf(stderr, "could not write tick %u, recording stopped\n",
+                _tickCount);
+        close();
+        return;
+    }
+    _tickCount++;
+}
+
+void ReplayRecorder::close() {
+    if (!_file) {
+        return;
+    }
+    fclose(_file);
+    _file = nullptr;
+    printf("recorded %u ticks\n", _tickCount);
+}
+
+bool Replay::load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "could not open replay %s\n", path);
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    ReplayHeader header;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != kReplayMagic ||
+        fread(&version, sizeof(version), 1, file) != 1 ||
+        version != kReplayVersion ||
+        fread(&header, sizeof(header), 1, file) != 1) {
+        fprintf(stderr, "%s is not a replay of this version\n", path);
+        fclose(file);
+        return false;
+    }
+
+    std::vector<GameCommand> commands;
+    std::vector<uint32_t> tickStarts{0};
+    uint32_t count;
+    bool isValid = true;
+    while (fread(&count, sizeof(count), 1, file) == 1) {
+        size_t start = commands.size();
+        commands.resize(start + count);
+        if (fread(commands.data() + start, sizeof(GameCommand), count, file) !=
+            count) {
+            fprintf(stderr, "%s: tick %zu is cut off\n", path,
+                    tickStarts.size() - 1);
+            isValid = false;
+            break;
+        }
+        tickStarts.push_back((uint32_t)commands.size());
+    }
+    fclose(file);
+    if (!isValid) {
+        return false;
+    }
+
+    _header = header;
+    _commands = std::move(commands);
+    _tickStarts = std::move(tickStarts);
+    return true;
+}
+
+std::span<const GameCommand> Replay::tick_commands(uint32_t tick) const {
+    uint32_t start = _tickStarts[tick];
+    return std::span<const GameCommand>(_commands.data() + start,
+                                        _tickStarts[tick + 1] - start);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "math/aabb.h"
+#include "math/frustum.h"
+#include "math/intersection.h"
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+enum class GameCommandType : uint8_t {
+    kPick,
+    kBoxSelect,
+    kMove,
+};
+
+/// A command of the player resolved against the camera of the frame it was
+/// given in, so it means the same thing however the camera moves on replay
+struct GameCommand {
+    GameCommandType type;
+    /// Pick
+    Ray ray;
+    /// Box select
+    math::Frustum frustum;
+    /// Move, on the ground
+    glm::vec3 point;
+};
+
+/// What a replay needs to rebuild the world the recording started from
+struct ReplayHeader {
+    /// Scenario units and orders, or the test entities
+    bool isScenario;
+    uint32_t mapChunks;
+    uint32_t entityCount;
+    // NOTE: An OrderPattern
+    uint32_t orders;
+    uint32_t orderInterval;
+    uint32_t seed;
+    /// Picks and box selections test against these, so a replay without the
+    /// meshes selects the same units
+    math::AABB unitBounds;
+    /// UnitArchetypes::fingerprint of the table the recording ran with. The
+    /// stats are not stored, so a replay with other ones is refused.
+    uint64_t archetypes;
+};
+
+/// Writes the commands of every tick to a file as the game runs. Structs are
+/// written as they are in memory, so only the same build reads them back.
+class ReplayRecorder {
+  public:
+    bool open(const char *path, const ReplayHeader &header);
+    bool is_open() const { return _file != nullptr; }
+    /// Once per tick, even without commands, so a replay runs as many ticks
+    void record_tick(std::span<const GameCommand> commands);
+    void close();
+
+  private:
+    FILE *_file{nullptr};
+    uint32_t _tickCount{0};
+};
+
+/// A recording read back whole, so playing it does not touch the disk
+class Replay {
+  public:
+    /// Returns false if the file cannot be read or was written by another
+    /// version
+    bool load(const char *path);
+
+    const ReplayHeader &header() const { return _header; }
+    uint32_t tick_count() const { return (uint32_t)_tickStarts.size() - 1; }
+    std::span<const GameCommand> tick_commands(uint32_t tick) const;
+
+  private:
+    ReplayHeader _header{};
+    std::vector<GameCommand> _commands;
+    // NOTE: The commands of tick i are [_tickStarts[i], _tickStarts[i + 1])
+    std::vector<uint32_t> _tickStarts{0};
+};
@@ -0,0 +1,124 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <chrono>
+
+SystemScheduler::SystemBuilder &
+SystemScheduler::SystemBuilder::reads_resource(const void *resource) {
+    _scheduler._systems[_index].resourceReads.push_back(resource);
+    return *this;
+}
+
+SystemScheduler::SystemBuilder &
+SystemScheduler::SystemBuilder::writes_resource(const void *resource) {
+    _scheduler._systems[_index].resourceWrites.push_back(resource);
+    return *this;
+}
+
+SystemScheduler::SystemBuilder
+SystemScheduler::add_system(const char *name, std::function<void()> fn) {
+    _systems.push_back(System{name, std::move(fn), false});
+    _isGraphDirty = true;
+    return SystemBuilder(*this, (uint32_t)_systems.size() - 1);
+}
+
+void SystemScheduler::add_sync_point(const char *name,
+                                     std::function<void()> fn) {
+    _systems.push_back(System{name, std::move(fn), true});
+    _isGraphDirty = true;
+}
+
+template <typename T>
+static bool overlaps(const std::vector<T> &a, const std::vector<T> &b) {
+    for (const T &value : a) {
+        if (std::find(b.begin(), b.end(), value) != b.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SystemScheduler::conflicts(const System &a, const System &b) {
+    if (a.isSyncPoint || b.isSyncPoint) {
+        return true;
+    }
+    return overlaps(a.writes, b.writes) || overlaps(a.writes, b.reads) ||
+           overlaps(a.reads, b.writes) ||
+           overlaps(a.resourceWrites, b.resourceWrites) ||
+           overlaps(a.resourceWrites, b.resourceReads) ||
+           overlaps(a.resourceReads, b.resourceWrites);
+}
+
+/**
+ * @brief Every system depends on the earlier systems it conflicts with. Edges
+ *        that are implied by a chain of others are kept, they only cost a
+ *        counter decrement.
+ */
+void SystemScheduler::build_graph() {
+    for (System &system : _systems) {
+        system.dependents.clear();
+        system.dependencyCount = 0;
+    }
+
+    for (uint32_t i = 0; i < _systems.size(); i++) {
+        for (uint32_t j = 0; j < i; j++) {
+            if (conflicts(_systems[j], _systems[i])) {
+                _systems[j].dependents.push_back(i);
+                _systems[i].dependencyCount++;
+            }
+        }
+    }
+
+    _remainingDependencies =
+        std::make_unique<std::atomic<uint32_t>[]>(_systems.size());
+    _isGraphDirty = false;
+}
+
+void SystemScheduler::launch(JobSystem &jobs, JobCounter &done,
+                             uint32_t index) {
+    jobs.run(_systems[index].name, done, [this, &jobs, &done, index] {
+        System &system = _systems[index];
+        auto start = std::chrono::steady_clock::now();
+        system.fn();
+        system.lastNanoseconds =
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+
+        // NOTE: Dependents are started before this job finishes, so done
+        // cannot drop to zero in between
+        for (uint32_t dependent : system.dependents) {
+            if (_remainingDependencies[dependent].fetch_sub(
+                    1, std::memory_order_acq_rel) == 1) {
+                launch(jobs, done, dependent);
+            }
+        }
+    });
+}
+
+void SystemScheduler::run(JobSystem &jobs) {
+    if (_isGraphDirty) {
+        build_graph();
+    }
+
+    for (uint32_t i = 0; i < _systems.size(); i++) {
+        _remainingDependencies[i].store(_systems[i].dependencyCount,
+                                        std::memory_order_relaxed);
+    }
+
+    JobCounter done;
+    for (uint32_t i = 0; i < _systems.size(); i++) {
+        if (_systems[i].dependencyCount == 0) {
+            launch(jobs, done, i);
+        }
+    }
+    jobs.wait(done);
+}
+
+void SystemScheduler::record_timings(TickStats &stats) const {
+    if (!stats.is_enabled()) {
+        return;
+    }
+    for (const System &system : _systems) {
+        stats.record(system.name, system.lastNanoseconds);
+    }
+}
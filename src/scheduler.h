@@ -0,0 +1,93 @@
+#pragma once
+#include "parallel.h"
+#include "tick_stats.h"
+#include <entt/entt.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// Runs systems on the job system in an order that respects what each of
+/// them touches. Two systems conflict when one writes a component or resource
+/// the other reads or writes. A system only waits for the earlier systems it
+/// conflicts with, everything else runs concurrently.
+///
+/// Systems must not create or destroy entities, and only add or remove the
+/// components they write. Other structural changes are recorded in a
+/// CommandBuffer and played back at a sync point, which waits for every
+/// system before it and runs alone.
+class SystemScheduler {
+  public:
+    class SystemBuilder {
+      public:
+        /// Components the system only reads
+        template <typename... T> SystemBuilder &reads();
+        /// Components the system modifies, adds or removes
+        template <typename... T> SystemBuilder &writes();
+        /// Anything outside the registry, identified by its address
+        SystemBuilder &reads_resource(const void *resource);
+        SystemBuilder &writes_resource(const void *resource);
+
+      private:
+        friend class SystemScheduler;
+        SystemBuilder(SystemScheduler &scheduler, uint32_t index)
+            : _scheduler(scheduler), _index(index) {}
+
+        SystemScheduler &_scheduler;
+        uint32_t _index;
+    };
+
+    explicit SystemScheduler(entt::registry &registry)
+        : _registry(registry) {}
+
+    /// Systems are ordered by registration where they conflict
+    SystemBuilder add_system(const char *name, std::function<void()> fn);
+    void add_sync_point(const char *name, std::function<void()> fn);
+
+    /// Runs every system once and returns when all of them are done
+    void run(JobSystem &jobs);
+    /// Adds the time each system took in the last run
+    void record_timings(TickStats &stats) const;
+
+  private:
+    struct System {
+        const char *name;
+        std::function<void()> fn;
+        bool isSyncPoint;
+        std::vector<entt::id_type> reads;
+        std::vector<entt::id_type> writes;
+        std::vector<const void *> resourceReads;
+        std::vector<const void *> resourceWrites;
+
+        // NOTE: Filled in when the graph is built
+        std::vector<uint32_t> dependents;
+        uint32_t dependencyCount;
+        uint64_t lastNanoseconds{0};
+    };
+
+    entt::registry &_registry;
+    std::vector<System> _systems;
+    std::unique_ptr<std::atomic<uint32_t>[]> _remainingDependencies;
+    bool _isGraphDirty{true};
+
+    void build_graph();
+    void launch(JobSystem &jobs, JobCounter &done, uint32_t index);
+    static bool conflicts(const System &a, const System &b);
+};
+
+template <typename... T>
+SystemScheduler::SystemBuilder &SystemScheduler::SystemBuilder::reads() {
+    System &system = _scheduler._systems[_index];
+    // NOTE: Creating the storage up front keeps systems from inserting into
+    // the registry's pool map while others look up theirs
+    (_scheduler._registry.storage<T>(), ...);
+    (system.reads.push_back(entt::type_hash<T>::value()), ...);
+    return *this;
+}
+
+template <typename... T>
+SystemScheduler::SystemBuilder &SystemScheduler::SystemBuilder::writes() {
+    System &system = _scheduler._systems[_index];
+    (_scheduler._registry.storage<T>(), ...);
+    (system.writes.push_back(entt::type_hash<T>::value()), ...);
+    return *this;
+}
@@ -0,0 +1,250 @@
+#include "spatial_grid.h"
+#include <algorithm>
+
+void SpatialGrid::init(TileMap *tm, uint32_t cellShift) {
+    assert(cellShift <= tm->chunk_shift);
+
+    _cellSize = tile_to_world(tm, 1 << cellShift);
+    _invCellSize = 1.f / _cellSize;
+    _cellsX = std::max((tm->n_tile_chunk_x * tm->chunk_dim) >> cellShift, 1u);
+    _cellsY = std::max((tm->n_tile_chunk_y * tm->chunk_dim) >> cellShift, 1u);
+    _maxRadius = 0.f;
+    _maxOutside = 0.f;
+
+    _cells.clear();
+    _cells.resize((size_t)_cellsX * _cellsY);
+    _locations.clear();
+}
+
+void SpatialGrid::clear() {
+    for (auto &cell : _cells) {
+        cell.clear();
+    }
+    _locations.clear();
+    _maxRadius = 0.f;
+    _maxOutside = 0.f;
+}
+
+glm::ivec2 SpatialGrid::cell_coords(const glm::vec2 &position) const {
+    // NOTE: Anything outside of the map ends up in the border cells
+    int32_t x = (int32_t)floorf(position.x * _invCellSize);
+    int32_t y = (int32_t)floorf(position.y * _invCellSize);
+    return glm::ivec2(std::clamp(x, 0, (int32_t)_cellsX - 1),
+                      std::clamp(y, 0, (int32_t)_cellsY - 1));
+}
+
+uint32_t SpatialGrid::cell_index(const glm::vec2 &position) const {
+    glm::ivec2 coords = cell_coords(position);
+    return (uint32_t)coords.y * _cellsX + (uint32_t)coords.x;
+}
+
+/// How far the position is past the edge of the map on either axis, 0 inside
+float SpatialGrid::outside_distance(const glm::vec2 &position) const {
+    glm::vec2 mapSize = glm::vec2((float)_cellsX, (float)_cellsY) * _cellSize;
+    glm::vec2 below = -position;
+    glm::vec2 above = position - mapSize;
+    return std::max(std::max(std::max(below.x, below.y),
+                             std::max(above.x, above.y)),
+                    0.f);
+}
+
+void SpatialGrid::insert(entt::entity entity, const glm::vec3 &position,
+                         float radius) {
+    assert(!contains(entity));
+
+    glm::vec2 groundPosition{position.x, position.z};
+    uint32_t cell = cell_index(groundPosition);
+    _locations.set(entity, Location{cell, (uint32_t)_cells[cell].size()});
+    _cells[cell].push_back(Entry{entity, groundPosition, radius});
+    _maxRadius = std::max(_maxRadius, radius);
+    _maxOutside = std::max(_maxOutside, outside_distance(groundPosition));
+}
+
+void SpatialGrid::remove_from_cell(uint32_t cell, uint32_t slot) {
+    std::vector<Entry> &entries = _cells[cell];
+    if (slot != entries.size() - 1) {
+        entries[slot] = entries.back();
+        _locations.find(entries[slot].entity)->slot = slot;
+    }
+    entries.pop_back();
+}
+
+void SpatialGrid::remove(entt::entity entity) {
+    assert(contains(entity));
+    Location location = *_locations.find(entity);
+    remove_from_cell(location.cell, location.slot);
+    _locations.erase(entity);
+}
+
+void SpatialGrid::move(entt::entity entity, const glm::vec3 &position) {
+    assert(contains(entity));
+    Location &location = *_locations.find(entity);
+    glm::vec2 groundPosition{position.x, position.z};
+    uint32_t cell = cell_index(groundPosition);
+    _maxOutside = std::max(_maxOutside, outside_distance(groundPosition));
+
+    if (cell == location.cell) {
+        _cells[cell][location.slot].position = groundPosition;
+        return;
+    }
+
+    Entry entry = _cells[location.cell][location.slot];
+    entry.position = groundPosition;
+    remove_from_cell(location.cell, location.slot);
+    location.cell = cell;
+    location.slot = (uint32_t)_cells[cell].size();
+    _cells[cell].push_back(entry);
+}
+
+bool SpatialGrid::contains(entt::entity entity) const {
+    return _locations.contains(entity);
+}
+
+void SpatialGrid::query_point(const glm::vec2 &point,
+                              std::vector<entt::entity> &out) const {
+    glm::ivec2 min = cell_coords(point - _maxRadius);
+    glm::ivec2 max = cell_coords(point + _maxRadius);
+
+    for (int32_t y = min.y; y <= max.y; y++) {
+        for (int32_t x = min.x; x <= max.x; x++) {
+            for (const Entry &entry : _cells[(uint32_t)y * _cellsX + x]) {
+                glm::vec2 offset = entry.position - point;
+                if (glm::dot(offset, offset) <= entry.radius * entry.radius) {
+                    out.push_back(entry.entity);
+                }
+            }
+        }
+    }
+}
+
+void SpatialGrid::query_aabb(const glm::vec2 &min, const glm::vec2 &max,
+                             std::vector<entt::entity> &out) const {
+    glm::ivec2 minCell = cell_coords(min - _maxRadius);
+    glm::ivec2 maxCell = cell_coords(max + _maxRadius);
+
+    for (int32_t y = minCell.y; y <= maxCell.y; y++) {
+        for (int32_t x = minCell.x; x <= maxCell.x; x++) {
+            for (const Entry &entry : _cells[(uint32_t)y * _cellsX + x]) {
+                glm::vec2 closest = glm::clamp(entry.position, min, max);
+                glm::vec2 offset = entry.position - closest;
+                if (glm::dot(offset, offset) <= entry.radius * entry.radius) {
+                    out.push_back(entry.entity);
+                }
+            }
+        }
+    }
+}
+
+void SpatialGrid::query_radius(const glm::vec2 &center, float radius,
+                               std::vector<entt::entity> &out) const {
+    glm::ivec2 min = cell_coords(center - (radius + _maxRadius));
+    glm::ivec2 max = cell_coords(center + (radius + _maxRadius));
+
+    for (int32_t y = min.y; y <= max.y; y++) {
+        for (int32_t x = min.x; x <= max.x; x++) {
+            for (const Entry &entry : _cells[(uint32_t)y * _cellsX + x]) {
+                glm::vec2 offset = entry.position - center;
+                float reach = radius + entry.radius;
+                if (glm::dot(offset, offset) <= reach * reach) {
+                    out.push_back(entry.entity);
+                }
+            }
+        }
+    }
+}
+
+void SpatialGrid::query_k_nearest(const glm::vec2 &point, uint32_t k,
+                                  std::vector<entt::entity> &out,
+                                  float maxDistance,
+                                  entt::entity exclude) const {
+    if (k == 0) {
+        return;
+    }
+
+    struct Candidate {
+        float distance2;
+        entt::entity entity;
+    };
+    auto closer = [](const Candidate &a, const Candidate &b) {
+        if (a.distance2 != b.distance2) {
+            return a.distance2 < b.distance2;
+        }
+        return entt::to_integral(a.entity) < entt::to_integral(b.entity);
+    };
+
+    // NOTE: Max-heap on distance, so the front is the worst of the k best
+    static thread_local std::vector<Candidate> heap;
+    heap.clear();
+
+    float maxDistance2 = std::min(maxDistance, 1e18f);
+    maxDistance2 *= maxDistance2;
+
+    auto visit = [&](int32_t x, int32_t y) {
+        if (x < 0 || y < 0 || x >= (int32_t)_cellsX || y >= (int32_t)_cellsY) {
+            return;
+        }
+        for (const Entry &entry : _cells[(uint32_t)y * _cellsX + x]) {
+            if (entry.entity == exclude) {
+                continue;
+            }
+            glm::vec2 offset = entry.position - point;
+            Candidate candidate{glm::dot(offset, offset), entry.entity};
+            if (candidate.distance2 > maxDistance2) {
+                continue;
+            }
+            if (heap.size() < k) {
+                heap.push_back(candidate);
+                std::push_heap(heap.begin(), heap.end(), closer);
+            } else if (closer(candidate, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), closer);
+                heap.back() = candidate;
+                std::push_heap(heap.begin(), heap.end(), closer);
+            }
+        }
+    };
+
+    glm::ivec2 center = cell_coords(point);
+    int32_t lastRing = std::max(
+        std::max(center.x, (int32_t)_cellsX - 1 - center.x),
+        std::max(center.y, (int32_t)_cellsY - 1 - center.y));
+
+    for (int32_t ring = 0; ring <= lastRing; ring++) {
+        if (ring > 0) {
+            // NOTE: Everything in this ring is at least as far away as the
+            // edge of the block of cells visited so far, less how far the
+            // border cells hold entities outside of the map
+            glm::vec2 blockMin =
+                glm::vec2(center - (ring - 1)) * _cellSize;
+            glm::vec2 blockMax = glm::vec2(center + ring) * _cellSize;
+            float bound = std::min(std::min(point.x - blockMin.x,
+                                            blockMax.x - point.x),
+                                   std::min(point.y - blockMin.y,
+                                            blockMax.y - point.y));
+            bound = std::max(bound - _maxOutside, 0.f);
+            float bound2 = bound * bound;
+            if (bound2 > maxDistance2 ||
+                (heap.size() == k && heap.front().distance2 <= bound2)) {
+                break;
+            }
+        }
+
+        if (ring == 0) {
+            visit(center.x, center.y);
+            continue;
+        }
+
+        for (int32_t x = center.x - ring; x <= center.x + ring; x++) {
+            visit(x, center.y - ring);
+            visit(x, center.y + ring);
+        }
+        for (int32_t y = center.y - ring + 1; y <= center.y + ring - 1; y++) {
+            visit(center.x - ring, y);
+            visit(center.x + ring, y);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), closer);
+    for (const Candidate &candidate : heap) {
+        out.push_back(candidate.entity);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "entity_slot_map.h"
+#include "tile.h"
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+/// Buckets entities by the ground cell they stand in, so queries only visit
+/// the cells around them instead of the whole registry. Positions are on the
+/// ground plane, x being world x and y being world z.
+class SpatialGrid {
+  public:
+    struct Entry {
+        entt::entity entity;
+        glm::vec2 position;
+        float radius;
+    };
+
+    /// Cells are (1 << cellShift) tiles wide and never straddle a tile chunk
+    void init(TileMap *tm, uint32_t cellShift = 3);
+    void clear();
+
+    void insert(entt::entity entity, const glm::vec3 &position, float radius);
+    void remove(entt::entity entity);
+    /// Only moves the entity to another bucket when it crossed a cell
+    void move(entt::entity entity, const glm::vec3 &position);
+    bool contains(entt::entity entity) const;
+
+    /// Entities whose footprint contains the point
+    void query_point(const glm::vec2 &point,
+                     std::vector<entt::entity> &out) const;
+    /// Entities whose footprint overlaps the rectangle
+    void query_aabb(const glm::vec2 &min, const glm::vec2 &max,
+                    std::vector<entt::entity> &out) const;
+    /// Entities whose footprint overlaps the circle
+    void query_radius(const glm::vec2 &center, float radius,
+                      std::vector<entt::entity> &out) const;
+    /// Up to k entities closest to the point within maxDistance, nearest
+    /// first. Ties are broken by entity id so results are deterministic.
+    void
+    query_k_nearest(const glm::vec2 &point, uint32_t k,
+                    std::vector<entt::entity> &out,
+                    float maxDistance = std::numeric_limits<float>::max(),
+                    entt::entity exclude = entt::null) const;
+
+  private:
+    struct Location {
+        uint32_t cell;
+        uint32_t slot;
+    };
+
+    float _cellSize;
+    float _invCellSize;
+    uint32_t _cellsX;
+    uint32_t _cellsY;
+    // NOTE: Footprints may stick out of their cell by at most this much, so
+    // queries grow their search area by it
+    float _maxRadius{0.f};
+    // NOTE: Entities outside of the map are kept in the border cells, at
+    // most this far out on either axis, so ring searches lower their stop
+    // bound by it
+    float _maxOutside{0.f};
+
+    std::vector<std::vector<Entry>> _cells;
+    EntitySlotMap<Location> _locations;
+
+    glm::ivec2 cell_coords(const glm::vec2 &position) const;
+    uint32_t cell_index(const glm::vec2 &position) const;
+    float outside_distance(const glm::vec2 &position) const;
+    void remove_from_cell(uint32_t cell, uint32_t slot);
+};
@@ -0,0 +1,66 @@
+#include "tick_stats.h"
+#include <algorithm>
+
+void TickStats::enable(uint32_t expectedTicks) {
+    _isEnabled = true;
+    _expectedTicks = expectedTicks;
+    _systems.clear();
+}
+
+void TickStats::record(const char *name, uint64_t nanoseconds) {
+    for (System &system : _systems) {
+        if (system.name == name) {
+            system.samples.push_back(nanoseconds);
+            return;
+        }
+    }
+
+    System &system = _systems.emplace_back(System{name, {}});
+    system.samples.reserve(_expectedTicks);
+    system.samples.push_back(nanoseconds);
+}
+
+void TimingRing::record(uint64_t nanoseconds) {
+    _samples[_next] = nanoseconds;
+    _next = (_next + 1) % kCapacity;
+    _count = std::min(_count + 1, kCapacity);
+}
+
+TimingPercentiles TimingRing::percentiles() const {
+    if (_count == 0) {
+        return TimingPercentiles{};
+    }
+
+    std::array<uint64_t, kCapacity> sorted;
+    std::copy(_samples.begin(), _samples.begin() + _count, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + _count);
+    auto rank = [this](double p) {
+        return (size_t)(p * (double)(_count - 1) + 0.5);
+    };
+    return TimingPercentiles{sorted[rank(0.5)], sorted[rank(0.95)],
+                             sorted[rank(0.99)], sorted[_count - 1]};
+}
+
+/// Nearest rank on sorted samples
+static double percentile_us(const std::vector<uint64_t> &sorted, double p) {
+    size_t rank = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+    return (double)sorted[rank] / 1000.0;
+}
+
+void TickStats::print(FILE *out) const {
+    fprintf(out, "%-24s %10s %10s %10s %10s\n", "system", "p50 us", "p90 us",
+            "p99 us", "max us");
+
+    std::vector<uint64_t> sorted;
+    for (const System &system : _systems) {
+        if (system.samples.empty()) {
+            continue;
+        }
+
+        sorted = system.samples;
+        std::sort(sorted.begin(), sorted.end());
+        fprintf(out, "%-24s %10.1f %10.1f %10.1f %10.1f\n", system.name,
+                percentile_us(sorted, 0.5), percentile_us(sorted, 0.9),
+                percentile_us(sorted, 0.99), percentile_us(sorted, 1.0));
+    }
+}
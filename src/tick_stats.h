@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/// Wall time of every fixed-step system over many ticks. Reported as
+/// percentiles so the occasional slow tick is not averaged away.
+class TickStats {
+  public:
+    /// Nothing is recorded until enabled, so the windowed game pays only for
+    /// a branch per system
+    void enable(uint32_t expectedTicks);
+    bool is_enabled() const { return _isEnabled; }
+
+    /// Runs fn and records its time under name. Names are compared by
+    /// pointer, so pass string literals.
+    template <typename F> void time(const char *name, F &&fn);
+    /// For times measured elsewhere, such as on other threads
+    void record(const char *name, uint64_t nanoseconds);
+
+    /// One row per system with the 50th, 90th and 99th percentile and the
+    /// worst tick, in microseconds
+    void print(FILE *out) const;
+
+  private:
+    struct System {
+        const char *name;
+        std::vector<uint64_t> samples;
+    };
+
+    bool _isEnabled{false};
+    uint32_t _expectedTicks{0};
+    std::vector<System> _systems;
+};
+
+/// In nanoseconds
+struct TimingPercentiles {
+    uint64_t p50{0};
+    uint64_t p95{0};
+    uint64_t p99{0};
+    uint64_t max{0};
+};
+
+/// The most recent samples of something measured every frame. Old samples
+/// are overwritten, so the percentiles follow the game as it runs.
+class TimingRing {
+  public:
+    static constexpr uint32_t kCapacity = 1024;
+
+    void record(uint64_t nanoseconds);
+    bool empty() const { return _count == 0; }
+    /// Sorts a copy of the samples, so call it a few times a second at most
+    TimingPercentiles percentiles() const;
+
+  private:
+    std::array<uint64_t, kCapacity> _samples;
+    uint32_t _next{0};
+    uint32_t _count{0};
+};
+
+/// How steadily the main loop ran, for the stats window
+struct LoopTimings {
+    TimingPercentiles frameTimes;
+    /// How late ticks started compared to their fixed schedule
+    TimingPercentiles tickLateness;
+    /// Ticks given up on because the loop fell too far behind
+    uint64_t droppedTicks{0};
+};
+
+template <typename F> void TickStats::time(const char *name, F &&fn) {
+    if (!_isEnabled) {
+        fn();
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    record(name, (uint64_t)elapsed.count());
+}
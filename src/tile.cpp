@@ -27,24 +27,17 @@ bool is_world_point_traversible(TileMap *tm, WorldPosition world_pos) {
                                      chunk_pos.tile_y);
 }
 
-World *generate_world(Arena *arena) {
-    const uint32_t n_tile_rows = 9;
-    const uint32_t n_tile_columns = 17;
-
-    TileChunk tile_chunks[2][2];
+World *generate_world(Arena *arena, uint32_t n_chunks_x,
+                      uint32_t n_chunks_y) {
     World *world = push_size<World>(arena);
     world->tile_map = push_size<TileMap>(arena);
     TileMap *tile_map = world->tile_map;
-    tile_map->tile_side_in_meters = 1.4f;
-    tile_map->tile_side_in_pixels = 60;
-    tile_map->meters_to_pixels =
-        tile_map->tile_side_in_pixels / (float)tile_map->tile_side_in_meters;
+    tile_map->tile_side = 1.f;
     tile_map->chunk_shift = 5;
     tile_map->chunk_mask = (1 << tile_map->chunk_shift) - 1;
     tile_map->chunk_dim = (1 << tile_map->chunk_shift);
-    tile_map->tile_chunks = (TileChunk *)tile_chunks;
-    tile_map->n_tile_chunk_x = 2;
-    tile_map->n_tile_chunk_y = 2;
+    tile_map->n_tile_chunk_x = n_chunks_x;
+    tile_map->n_tile_chunk_y = n_chunks_y;
 
     tile_map->tile_chunks = push_array<TileChunk>(
         arena, tile_map->n_tile_chunk_x * tile_map->n_tile_chunk_y);
@@ -74,8 +67,7 @@ World *generate_world(Arena *arena) {
 }
 
 static std::vector<TileInstance> create_tile_chunk_mesh(TileChunk *chunk,
-                                                        uint32_t chunkDim,
-                                                        uint32_t tileWidth) {
+                                                        uint32_t chunkDim) {
     std::vector<TileInstance> instances(chunkDim * chunkDim);
 
     for (uint32_t row = 0; row < chunkDim; row++) {
@@ -94,21 +86,27 @@ static std::vector<TileInstance> create_tile_chunk_mesh(TileChunk *chunk,
     return instances;
 }
 
-std::vector<TileRenderingInput> create_tile_map_mesh(TileMap *tm) {
+std::vector<TileRenderingInput> create_tile_map_mesh(TileMap *tm,
+                                                     JobSystem *jobs) {
     std::vector<TileRenderingInput> chunks(tm->n_tile_chunk_x *
                                            tm->n_tile_chunk_y);
 
-    for (uint32_t row = 0; row < tm->n_tile_chunk_y; row++) {
-        for (uint32_t col = 0; col < tm->n_tile_chunk_x; col++) {
-            TileRenderingInput chunk;
-            chunk.instances = create_tile_chunk_mesh(
-                &tm->tile_chunks[row * tm->n_tile_chunk_x + col], tm->chunk_dim,
-                tm->tile_side_in_pixels);
+    auto build = [tm, &chunks](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t row = i / tm->n_tile_chunk_x;
+            uint32_t col = i % tm->n_tile_chunk_x;
+            TileRenderingInput &chunk = chunks[i];
+            chunk.instances =
+                create_tile_chunk_mesh(&tm->tile_chunks[i], tm->chunk_dim);
             chunk.chunkPosition =
                 glm::vec3(col * tm->chunk_dim, 0.f, row * tm->chunk_dim);
-            chunks[row * tm->n_tile_chunk_x + col] = chunk;
         }
-    }
+    };
 
+    if (jobs) {
+        jobs->parallel_for((uint32_t)chunks.size(), 1, build, "tile_mesh");
+    } else {
+        build(0, (uint32_t)chunks.size());
+    }
     return chunks;
 }
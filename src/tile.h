@@ -1,34 +1,24 @@
 #pragma once
 #include "math/transform.h"
 #include "memory.h"
+#include "parallel.h"
 #include "renderer/pipelines/tile.h"
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 
+struct TileMap;
+
+/// A point on the ground as a tile and an offset into it. tile_rel is in
+/// world units from the start of the tile.
 struct WorldPosition {
     uint32_t abs_tile_x;
     uint32_t abs_tile_y;
     float tile_rel_x;
     float tile_rel_y;
 
-    Transform to_world_transform() {
-        Transform transform;
-        transform.position(
-            // TODO: This only works if the tile side is 1.0f
-            glm::vec3(abs_tile_x + tile_rel_x, 0.f, abs_tile_y + tile_rel_y));
-        return transform;
-    }
-
-    WorldPosition from_transform(Transform transform) {
-        glm::vec3 pos = transform.position();
-        WorldPosition world_pos;
-        world_pos.abs_tile_x = (uint32_t)floorf(pos.x);
-        world_pos.abs_tile_y = (uint32_t)floorf(pos.z);
-        std::modf(pos.x, &world_pos.tile_rel_x);
-        std::modf(pos.z, &world_pos.tile_rel_y);
-        return world_pos;
-    }
+    Transform to_world_transform(TileMap *tm) const;
+    static WorldPosition from_world_point(TileMap *tm, glm::vec3 point);
 };
 
 struct TileChunk {
@@ -43,9 +33,9 @@ struct TileChunkPosition {
 };
 
 struct TileMap {
-    float tile_side_in_meters;
-    int tile_side_in_pixels;
-    float meters_to_pixels;
+    /// World units per tile side. The tile mesh and the fog of war shader
+    /// draw tiles one unit wide, so it stays 1 until they read it too.
+    float tile_side;
 
     // NOTE: We use 32x32 tile chunks
     uint32_t chunk_shift;
@@ -63,17 +53,51 @@ struct World {
 };
 
 bool is_world_point_traversible(TileMap *tm, WorldPosition world_pos);
-World *generate_world(Arena *arena);
-std::vector<TileRenderingInput> create_tile_map_mesh(TileMap *tm);
+World *generate_world(Arena *arena, uint32_t n_chunks_x = 2,
+                      uint32_t n_chunks_y = 2);
+/// Chunks are built in parallel when given a job system
+std::vector<TileRenderingInput> create_tile_map_mesh(TileMap *tm,
+                                                     JobSystem *jobs = nullptr);
+
+/// Where a tile starts along either axis of the ground plane
+inline float tile_to_world(TileMap *tm, int32_t tile) {
+    return (float)tile * tm->tile_side;
+}
+
+/// The tile a coordinate on either axis of the ground plane falls in.
+/// Outside of the map that can be negative or past the last tile.
+inline int32_t world_to_tile(TileMap *tm, float world) {
+    return (int32_t)floorf(world / tm->tile_side);
+}
+
+inline Transform WorldPosition::to_world_transform(TileMap *tm) const {
+    Transform transform;
+    transform.position(
+        glm::vec3(tile_to_world(tm, (int32_t)abs_tile_x) + tile_rel_x, 0.f,
+                  tile_to_world(tm, (int32_t)abs_tile_y) + tile_rel_y));
+    return transform;
+}
+
+/// Points outside of the map wrap around to huge tile indices
+inline WorldPosition WorldPosition::from_world_point(TileMap *tm,
+                                                     glm::vec3 point) {
+    int32_t tileX = world_to_tile(tm, point.x);
+    int32_t tileY = world_to_tile(tm, point.z);
+    return WorldPosition{(uint32_t)tileX, (uint32_t)tileY,
+                         point.x - tile_to_world(tm, tileX),
+                         point.z - tile_to_world(tm, tileY)};
+}
 
+/// Moves whole tiles out of tile_rel until it is inside its tile
 inline void normalize_world_coord(TileMap *tm, uint32_t *tile,
                                   float *tile_rel) {
-    int offset = (int)roundf(*tile_rel / tm->tile_side_in_meters);
+    int offset = (int)floorf(*tile_rel / tm->tile_side);
     *tile += offset;
-    *tile_rel -= (float)offset * tm->tile_side_in_meters;
+    *tile_rel -= (float)offset * tm->tile_side;
 
-    assert(*tile_rel >= -tm->tile_side_in_meters / 2.0f);
-    assert(*tile_rel <= tm->tile_side_in_meters / 2.0f);
+    // NOTE: A tiny negative tile_rel rounds up to a whole tile
+    assert(*tile_rel >= 0.f);
+    assert(*tile_rel <= tm->tile_side);
 }
 
 inline WorldPosition normalize_world_position(TileMap *tm, WorldPosition pos) {
@@ -105,3 +129,20 @@ inline TileChunk *get_tile_chunk(TileMap *tm, uint32_t tile_chunk_x,
 
     return tile_chunk;
 }
+
+// NOTE: Tiles outside of the map are never traversible
+inline bool is_tile_traversible(TileMap *tm, int32_t abs_tile_x,
+                                int32_t abs_tile_y) {
+    if (abs_tile_x < 0 || abs_tile_y < 0) {
+        return false;
+    }
+
+    TileChunkPosition chunk_pos =
+        get_chunk_position(tm, (uint32_t)abs_tile_x, (uint32_t)abs_tile_y);
+    TileChunk *chunk = get_tile_chunk(tm, chunk_pos.chunk_x, chunk_pos.chunk_y);
+    if (!chunk) {
+        return false;
+    }
+    return chunk->tiles[chunk_pos.tile_y * tm->chunk_dim + chunk_pos.tile_x] ==
+           0;
+}
@@ -0,0 +1,153 @@
+#include "unit_archetypes.h"
+#include <cstdio>
+#include <cstring>
+
+struct ArchetypeDefinition {
+    std::string name;
+    ArchetypeStats stats;
+    std::string meshPath;
+};
+
+static bool parse_definitions(const char *path,
+                              std::vector<ArchetypeDefinition> &out) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "could not open unit definitions %s\n", path);
+        return false;
+    }
+
+    char line[512];
+    uint32_t lineNumber = 0;
+    bool isValid = true;
+    while (isValid && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        const char *start = line + strspn(line, " \t\r\n");
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+
+        char name[64];
+        char meshPath[256] = "";
+        ArchetypeDefinition definition;
+        definition.stats.mesh = UnitArchetypes::kNoMesh;
+        int fields = sscanf(start, "%63s %f %f %u %255s", name,
+                            &definition.stats.movementSpeed,
+                            &definition.stats.radius,
+                            &definition.stats.sightRadius, meshPath);
+        if (fields < 4 || definition.stats.movementSpeed <= 0.f ||
+            definition.stats.radius <= 0.f) {
+            fprintf(stderr, "%s:%u: expected name, speed, radius, sight and "
+                            "an optional mesh\n",
+                    path, lineNumber);
+            isValid = false;
+            break;
+        }
+
+        definition.name = name;
+        definition.meshPath = meshPath;
+        for (const ArchetypeDefinition &other : out) {
+            if (other.name == definition.name) {
+                fprintf(stderr, "%s:%u: %s is defined twice\n", path,
+                        lineNumber, name);
+                isValid = false;
+            }
+        }
+        out.push_back(std::move(definition));
+    }
+
+    fclose(file);
+    return isValid;
+}
+
+bool UnitArchetypes::load(const char *path) {
+    std::error_code error;
+    std::filesystem::file_time_type writeTime =
+        std::filesystem::last_write_time(path, error);
+
+    std::vector<ArchetypeDefinition> definitions;
+    if (!parse_definitions(path, definitions)) {
+        return false;
+    }
+
+    uint32_t newCount = _count;
+    for (const ArchetypeDefinition &definition : definitions) {
+        if (find(definition.name) == kInvalidArchetype) {
+            newCount++;
+        }
+    }
+    if (newCount > kMaxArchetypes) {
+        fprintf(stderr, "%s: more than %u archetypes\n", path,
+                kMaxArchetypes);
+        return false;
+    }
+
+    for (ArchetypeDefinition &definition : definitions) {
+        uint16_t index = find(definition.name);
+        if (index == kInvalidArchetype) {
+            index = (uint16_t)_count++;
+            _names.push_back(definition.name);
+            _meshPaths.emplace_back();
+        } else if (_meshPaths[index] == definition.meshPath) {
+            definition.stats.mesh = _stats[index].mesh;
+        }
+
+        _stats[index] = definition.stats;
+        _meshPaths[index] = std::move(definition.meshPath);
+    }
+
+    _path = path;
+    _loadedWriteTime = writeTime;
+    return true;
+}
+
+bool UnitArchetypes::reload_if_changed() {
+    if (_path.empty()) {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::file_time_type writeTime =
+        std::filesystem::last_write_time(_path, error);
+    if (error || writeTime == _loadedWriteTime) {
+        return false;
+    }
+
+    // NOTE: A file that fails to parse is most likely still being edited, so
+    // it is not read again until the next write
+    if (!load(_path.c_str())) {
+        _loadedWriteTime = writeTime;
+        return false;
+    }
+    return true;
+}
+
+// NOTE: FNV-1a
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t UnitArchetypes::fingerprint() const {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t i = 0; i < _count; i++) {
+        const ArchetypeStats &stats = _stats[i];
+        hash = hash_bytes(hash, _names[i].data(), _names[i].size() + 1);
+        hash = hash_bytes(hash, &stats.movementSpeed,
+                          sizeof(stats.movementSpeed));
+        hash = hash_bytes(hash, &stats.radius, sizeof(stats.radius));
+        hash = hash_bytes(hash, &stats.sightRadius, sizeof(stats.sightRadius));
+    }
+    return hash;
+}
+
+uint16_t UnitArchetypes::find(std::string_view name) const {
+    for (uint32_t i = 0; i < _count; i++) {
+        if (_names[i] == name) {
+            return (uint16_t)i;
+        }
+    }
+    return kInvalidArchetype;
+}
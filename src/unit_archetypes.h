@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// What a unit stores instead of its definition, the index of its archetype
+/// in UnitArchetypes
+struct ArchetypeId {
+    uint16_t index;
+};
+
+/// The fields systems read while the game runs, kept apart from the cold
+/// ones so four archetypes share a cache line
+struct alignas(16) ArchetypeStats {
+    float movementSpeed;
+    float radius;
+    uint32_t sightRadius;
+    /// Index of the mesh the game loaded for the archetype
+    uint32_t mesh;
+};
+
+/// Unit definitions read from a text file with one archetype per line:
+///
+///     # name  speed  radius  sight  [mesh]
+///     Cube    2.0    0.5     6      assets/meshes/mannequin.glb
+///
+/// An archetype keeps its index when the file is loaded again, matched by
+/// name, so units keep pointing at the right one. Archetypes removed from
+/// the file stay in the table for the units that still use them.
+class UnitArchetypes {
+  public:
+    static constexpr uint32_t kMaxArchetypes = 256;
+    static constexpr uint16_t kInvalidArchetype = UINT16_MAX;
+    static constexpr uint32_t kNoMesh = UINT32_MAX;
+
+    /// Leaves the table as it was and returns false if the file cannot be
+    /// read or has an error
+    bool load(const char *path);
+    /// Loads the file again if it was written since the last load, and
+    /// returns true if the table changed
+    bool reload_if_changed();
+
+    /// kInvalidArchetype if there is no archetype with that name
+    uint16_t find(std::string_view name) const;
+    uint32_t size() const { return _count; }
+    /// Changes whenever a name or a stat the simulation reads changes.
+    /// Meshes are left out, they only matter for drawing.
+    uint64_t fingerprint() const;
+
+    const ArchetypeStats &stats(ArchetypeId id) const {
+        return _stats[id.index];
+    }
+    const std::string &name(ArchetypeId id) const { return _names[id.index]; }
+    /// Empty if the archetype has no mesh. The mesh goes back to kNoMesh
+    /// when a reload changes the path.
+    const std::string &mesh_path(ArchetypeId id) const {
+        return _meshPaths[id.index];
+    }
+    void set_mesh(ArchetypeId id, uint32_t mesh) {
+        _stats[id.index].mesh = mesh;
+    }
+
+  private:
+    alignas(64) ArchetypeStats _stats[kMaxArchetypes];
+    uint32_t _count{0};
+    // NOTE: Cold data, only read when loading and when resolving meshes
+    std::vector<std::string> _names;
+    std::vector<std::string> _meshPaths;
+
+    std::string _path;
+    std::filesystem::file_time_type _loadedWriteTime;
+};